@@ -0,0 +1,243 @@
+#ifndef AUTOMATIONSTREAM_H
+#define AUTOMATIONSTREAM_H
+
+#include <stdint.h>
+
+#define AUTOMATION_COARSE 64 // samples, divides the block length up to 512 Hz control rate at 32768 Hz
+#define AUTOMATION_ID_ESCAPE 0x7F // 7 bit id field value meaning "the id follows"
+
+/*  Delta encoded parameter automation stream.
+
+    Events are (time, parameter id, index, value) with non-decreasing times
+    in samples. Each event is stored as
+      varint(time delta << 2 | coarse << 1 | same slot)
+      same slot:   zigzag varint(value - previous value)
+      otherwise:   id (bit 7 set when an index byte follows), [id], [index], zigzag varint(value)
+    Ids below AUTOMATION_ID_ESCAPE fit the id byte; higher ids store the
+    escape there and the id in a second byte.
+    GUI values arrive from updateControl(), so most time deltas are whole
+    control blocks; those are stored in units of AUTOMATION_COARSE samples
+    ("coarse"). "Same slot" means same id and index as the previous event,
+    so a knob sweep costs 2 bytes per event and a note about 5.
+
+    The buffer is owned by the caller (PSRAM on the synth). Writing and
+    reading share the buffer but keep separate state, reading happens once
+    per control block and never allocates.
+*/
+
+enum automationModes
+{
+  automationStop,
+  automationRecord,
+  automationPlay,
+  automationLoop
+};
+
+struct AutomationEvent
+{
+  uint32_t time; // samples since the start of the recording
+  uint8_t id;
+  uint8_t index;
+  int32_t value;
+};
+
+class AutomationStream
+{
+public:
+  AutomationStream() : buffer(0), capacity(0), length(0), count(0)
+  {
+    clear();
+  }
+
+  void begin(uint8_t *buf, uint32_t size)
+  {
+    buffer = buf;
+    capacity = size;
+    clear();
+  }
+
+  void clear()
+  {
+    length = 0;
+    count = 0;
+    writeLast.time = 0;
+    writeLast.id = 0xFF;
+    writeLast.index = 0;
+    writeLast.value = 0;
+    rewind();
+  }
+
+  // false when the buffer is full or the time goes backwards, the event is then not stored
+  bool append(const AutomationEvent &e)
+  {
+    if (e.time < writeLast.time)
+      return false;
+    uint8_t bytes[16];
+    uint8_t n = 0;
+    bool same = e.id == writeLast.id && e.index == writeLast.index;
+    uint32_t delta = e.time - writeLast.time; // below 2^30
+    bool coarse = delta % AUTOMATION_COARSE == 0;
+    if (coarse)
+      delta /= AUTOMATION_COARSE;
+    n += putVarint(bytes + n, (delta << 2) | (coarse << 1) | same);
+    if (same)
+    {
+      n += putVarint(bytes + n, zigzag(e.value - writeLast.value));
+    }
+    else
+    {
+      bool escaped = e.id >= AUTOMATION_ID_ESCAPE;
+      bytes[n++] = (escaped ? AUTOMATION_ID_ESCAPE : e.id) | (e.index ? 0x80 : 0);
+      if (escaped)
+        bytes[n++] = e.id;
+      if (e.index)
+        bytes[n++] = e.index;
+      n += putVarint(bytes + n, zigzag(e.value));
+    }
+    if (length + n > capacity)
+      return false;
+    for (uint8_t i = 0; i < n; i++)
+      buffer[length++] = bytes[i];
+    writeLast = e;
+    count++;
+    return true;
+  }
+
+  void rewind()
+  {
+    readPos = 0;
+    readLast.time = 0;
+    readLast.id = 0xFF;
+    readLast.index = 0;
+    readLast.value = 0;
+    pendingValid = false;
+  }
+
+  // true when the next event is due at or before time, decodes it on the first call
+  bool due(uint32_t time)
+  {
+    if (!pendingValid)
+      pendingValid = decode(pending);
+    return pendingValid && pending.time <= time;
+  }
+
+  bool read(AutomationEvent &e)
+  {
+    if (!pendingValid && !(pendingValid = decode(pending)))
+      return false;
+    e = pending;
+    pendingValid = false;
+    return true;
+  }
+
+  bool finished()
+  {
+    return !pendingValid && readPos >= length;
+  }
+
+  uint32_t size() const
+  {
+    return length;
+  }
+
+  uint32_t events() const
+  {
+    return count;
+  }
+
+  uint32_t duration() const
+  {
+    return writeLast.time;
+  }
+
+private:
+  uint8_t *buffer;
+  uint32_t capacity;
+  uint32_t length;
+  uint32_t count;
+  AutomationEvent writeLast;
+  uint32_t readPos;
+  AutomationEvent readLast;
+  AutomationEvent pending;
+  bool pendingValid;
+
+  static uint32_t zigzag(int32_t v)
+  {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+  }
+
+  static int32_t unzigzag(uint32_t v)
+  {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+  }
+
+  static uint8_t putVarint(uint8_t *out, uint32_t v)
+  {
+    uint8_t n = 0;
+    while (v >= 0x80)
+    {
+      out[n++] = (uint8_t)v | 0x80;
+      v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+  }
+
+  bool getVarint(uint32_t &v)
+  {
+    v = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7)
+    {
+      if (readPos >= length)
+        return false;
+      uint8_t b = buffer[readPos++];
+      v |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool decode(AutomationEvent &e)
+  {
+    uint32_t header, v;
+    if (!getVarint(header))
+      return false;
+    e.time = readLast.time + (header >> 2) * (header & 2 ? AUTOMATION_COARSE : 1);
+    if (header & 1)
+    {
+      if (!getVarint(v))
+        return false;
+      e.id = readLast.id;
+      e.index = readLast.index;
+      e.value = readLast.value + unzigzag(v);
+    }
+    else
+    {
+      if (readPos >= length)
+        return false;
+      uint8_t id = buffer[readPos++];
+      e.id = id & 0x7F;
+      if (e.id == AUTOMATION_ID_ESCAPE)
+      {
+        if (readPos >= length)
+          return false;
+        e.id = buffer[readPos++];
+      }
+      e.index = 0;
+      if (id & 0x80)
+      {
+        if (readPos >= length)
+          return false;
+        e.index = buffer[readPos++];
+      }
+      if (!getVarint(v))
+        return false;
+      e.value = unzigzag(v);
+    }
+    readLast = e;
+    return true;
+  }
+};
+
+#endif /* AUTOMATIONSTREAM_H */
@@ -0,0 +1,228 @@
+#ifndef BLOCKENVELOPE_H
+#define BLOCKENVELOPE_H
+
+#include <stdint.h>
+#include <math.h>
+#include "HotPath.h"
+
+/*  Envelope with curved segments, drop-in for Mozzi's ADSR.
+
+    Same four phases and level/time semantics as ADSR (the sustain phase
+    has its own time and then falls into release). Each segment is an
+    exponential approach, computed once per block in update() with a
+    multiply-recurrence aimed slightly past the segment target, so the
+    target is reached exactly after the segment time and the segment is
+    then snapped onto it. value() is the 16 bit level at the end of the
+    block; nothing runs per sample. A voice folds it into its level once
+    per block and lets a GainRamp carry envelope and level through the
+    block, in the multiply it does anyway.
+    One instance holds the state of one voice.
+*/
+
+enum envPhases
+{
+  envAttack,
+  envDecay,
+  envSustain,
+  envRelease,
+  envIdle
+};
+
+enum envModes
+{
+  envRetrigger, // every noteOn restarts the attack from the current level
+  envLegato     // noteOn while the gate is held keeps the running phase
+};
+
+class BlockEnvelope
+{
+public:
+  explicit BlockEnvelope(unsigned int update_rate) : phase(envIdle), mode(envRetrigger), blockEnd(0), target(0), overshoot(0), blocksLeft(0)
+  {
+    for (uint8_t i = 0; i < envIdle; i++)
+    {
+      levels[i] = 0;
+      times[i] = 0;
+    }
+    // attack bends like a charging capacitor, the falling segments are steeper
+    curves[envAttack] = 0.25f;
+    curves[envDecay] = 0.01f;
+    curves[envSustain] = 0.01f;
+    curves[envRelease] = 0.01f;
+    setRate(update_rate);
+  }
+
+  void setRate(unsigned int update_rate)
+  {
+    updateRate = update_rate;
+    for (uint8_t i = 0; i < envIdle; i++)
+    {
+      setTime(i, times[i]);
+    }
+  }
+
+  void setMode(uint8_t m)
+  {
+    mode = m;
+  }
+
+  // Remaining distance to the segment end after the whole segment, 0 < c < 1.
+  // Small values give a strongly curved segment, values near 1 are almost linear.
+  void setCurve(uint8_t p, float c)
+  {
+    if (p < envIdle && c > 0.0f && c < 1.0f)
+    {
+      curves[p] = c;
+      setTime(p, times[p]);
+    }
+  }
+
+  void setLevels(uint8_t attack, uint8_t decay, uint8_t sustain, uint8_t release)
+  {
+    levels[envAttack] = attack;
+    levels[envDecay] = decay;
+    levels[envSustain] = sustain;
+    levels[envRelease] = release;
+  }
+
+  void setTimes(unsigned int attack_ms, unsigned int decay_ms, unsigned int sustain_ms, unsigned int release_ms)
+  {
+    setTime(envAttack, attack_ms);
+    setTime(envDecay, decay_ms);
+    setTime(envSustain, sustain_ms);
+    setTime(envRelease, release_ms);
+  }
+
+  void setAttackLevel(uint8_t value) { levels[envAttack] = value; }
+  void setDecayLevel(uint8_t value) { levels[envDecay] = value; }
+  void setSustainLevel(uint8_t value) { levels[envSustain] = value; }
+  void setReleaseLevel(uint8_t value) { levels[envRelease] = value; }
+
+  void setAttackTime(unsigned int ms) { setTime(envAttack, ms); }
+  void setDecayTime(unsigned int ms) { setTime(envDecay, ms); }
+  void setSustainTime(unsigned int ms) { setTime(envSustain, ms); }
+  void setReleaseTime(unsigned int ms) { setTime(envRelease, ms); }
+
+  void noteOn()
+  {
+    if (mode == envLegato && phase < envRelease)
+      return;
+    startPhase(envAttack);
+  }
+
+  // Attack from silence whatever the mode, for a voice that was not rendered for a while
+  void restart()
+  {
+    blockEnd = 0;
+    startPhase(envAttack);
+  }
+
+  void noteOff()
+  {
+    if (phase < envRelease)
+      startPhase(envRelease);
+  }
+
+  // Once per block: advance the segment recurrence to the end of the block
+  void update()
+  {
+    if (phase != envIdle)
+    {
+      if (--blocksLeft == 0)
+      {
+        blockEnd = target;
+        startPhase(phase + 1);
+      }
+      else
+      {
+        blockEnd = overshoot + (int32_t)(((int64_t)(blockEnd - overshoot) * keep[phase]) >> 30);
+        if ((int64_t)(blockEnd - target) * (overshoot - target) > 0) // rounding ran past the target early
+          blockEnd = target;
+      }
+    }
+  }
+
+  // 16 bit envelope value at the end of the block
+  uint16_t value() const
+  {
+    return (uint16_t)(blockEnd >> 8);
+  }
+
+  bool playing() const
+  {
+    return phase != envIdle;
+  }
+
+  uint8_t getPhase() const
+  {
+    return phase;
+  }
+
+private:
+  uint8_t phase;
+  uint8_t mode;
+  unsigned int updateRate;
+  int32_t blockEnd; // value at the end of the block, 16.8 fixed point of the 16 bit output
+  int32_t target;
+  int32_t overshoot;
+  uint32_t blocksLeft;
+  uint8_t levels[envIdle];
+  unsigned int times[envIdle];
+  uint32_t blocks[envIdle];
+  uint32_t keep[envIdle]; // Q30 factor applied to the remaining distance each block
+  float curves[envIdle];
+
+  void setTime(uint8_t p, unsigned int ms)
+  {
+    times[p] = ms;
+    uint32_t n = ((uint32_t)ms * updateRate + 500) / 1000;
+    if (n < 1)
+      n = 1;
+    blocks[p] = n;
+    // aim at target + eps * (target - start) with eps / (1 + eps) = curve,
+    // then (1 - coefficient)^n = curve lands exactly on the target after n blocks
+    keep[p] = (uint32_t)(pow(curves[p], 1.0 / n) * 1073741824.0);
+  }
+
+  void startPhase(uint8_t p)
+  {
+    phase = p;
+    if (p == envIdle)
+      return;
+    target = (int32_t)levels[p] * 257 << 8;
+    float eps = curves[p] / (1.0f - curves[p]);
+    overshoot = target + (int32_t)(eps * (float)(target - blockEnd));
+    blocksLeft = blocks[p];
+  }
+};
+
+// Per-sample gain, ramped linearly to a new value over each block
+class GainRamp
+{
+public:
+  GainRamp() : current(0), step(0), blockSize(1) {}
+
+  void setBlockSize(uint16_t block_size)
+  {
+    blockSize = block_size ? block_size : 1;
+  }
+
+  // Once per block, gain reached at its end, -65535..65535
+  void to(int32_t gain)
+  {
+    step = ((gain << 8) - current) / (int32_t)blockSize;
+  }
+
+  inline AUDIO_HOT int32_t next()
+  {
+    current += step;
+    return current >> 8;
+  }
+
+private:
+  int32_t current; // 16.8
+  int32_t step;
+  uint16_t blockSize;
+};
+
+#endif /* BLOCKENVELOPE_H */
@@ -0,0 +1,49 @@
+#ifndef DISTORTION_H
+#define DISTORTION_H
+
+#include "HotPath.h"
+
+// Pre/post distortion of the signal chain, mode 0 clips, mode 1 folds back.
+// Shared between the firmware and the host render tools.
+inline AUDIO_HOT int distortion(int signal, int amount, bool enabled, int mode)
+{
+  if (enabled)
+  {
+    amount = 1 + amount / 51;
+    if (mode == 0)
+    {
+      int output = signal * amount;
+      if (output > 24500) // almost 3/4 of 2^15 (amplitude goes to max 16bit/2), left a little bit of headroom
+      {
+        return 24500;
+      }
+      if (output < -24500)
+      {
+        return -24500;
+      }
+      else
+      {
+        return output;
+      }
+    }
+    if (mode == 1)
+    {
+      int output = signal * amount;
+      if (output > 32768)
+      {
+        return 32768 - (output - 32768);
+      }
+      if (output < -32768)
+      {
+        return -32768 - (output + 32768);
+      }
+      else
+      {
+        return output;
+      }
+    }
+  }
+  return signal;
+}
+
+#endif /* DISTORTION_H */
@@ -0,0 +1,63 @@
+#ifndef GLIDE_H
+#define GLIDE_H
+
+#include <stdint.h>
+#include <math.h>
+
+/*  Portamento of OSC 1 / OSC 2, ticked once per control block.
+
+    Like Mozzi's Portamento: start() aims a linear ramp of the 16.16
+    frequency at the new note, spread over time * control rate / 1024
+    blocks, and next() steps it once per block. The control rate is a
+    member, so glide times stay right at every boot time control rate
+    without rescaling. Pitch is computed in start(), never per block.
+*/
+
+class Glide
+{
+public:
+  Glide() : controlRate(256), steps(0), countdown(0), current(0), target(0), step(0) {}
+
+  void setRate(uint16_t control_rate)
+  {
+    controlRate = control_rate;
+  }
+
+  // ms, 0 jumps straight to the note
+  void setTime(unsigned int ms)
+  {
+    steps = ((uint32_t)ms * controlRate) >> 10;
+  }
+
+  void start(uint8_t note)
+  {
+    target = (int32_t)(440.0f * powf(2.0f, (note - 69) / 12.0f) * 65536.0f);
+    countdown = steps;
+    if (steps == 0)
+      current = target;
+    else
+      step = (target - current) / (int32_t)steps;
+  }
+
+  // Once per control block, 16.16 Hz
+  int32_t next()
+  {
+    if (countdown)
+    {
+      current += step;
+      if (--countdown == 0)
+        current = target;
+    }
+    return current;
+  }
+
+private:
+  uint16_t controlRate;
+  uint32_t steps;
+  uint32_t countdown;
+  int32_t current; // 16.16 Hz
+  int32_t target;
+  int32_t step;
+};
+
+#endif /* GLIDE_H */
@@ -0,0 +1,20 @@
+#ifndef HOTPATH_H
+#define HOTPATH_H
+
+/*  Placement of the audio path.
+
+    AUDIO_HOT puts a function into IRAM and AUDIO_DATA puts data into
+    internal DRAM on the ESP32, so rendering and the audio output ISR don't
+    depend on the flash cache. On other targets (host tools) both are empty.
+*/
+
+#if defined(ESP32)
+#include <esp_attr.h>
+#define AUDIO_HOT IRAM_ATTR
+#define AUDIO_DATA DRAM_ATTR
+#else
+#define AUDIO_HOT
+#define AUDIO_DATA
+#endif
+
+#endif /* HOTPATH_H */
@@ -0,0 +1,136 @@
+#ifndef LATENCYTRACE_H
+#define LATENCYTRACE_H
+
+#include <stdint.h>
+#include "HotPath.h"
+
+/*  Key-to-sound latency tracer.
+
+    One note event is followed at a time through three stamps:
+      scanned()  - key change seen by the key scan (control side)
+      rendered() - first updateAudio() sample computed after it
+      output()   - the DAC write of that same sample (audio output ISR)
+    rendered() and output() are called for every sample and only do work
+    while an event is in flight. Events arriving while one is in flight are
+    counted as skipped. Times are in microseconds, sample positions use a
+    free running sample counter on both sides.
+*/
+
+#define LATENCY_BUCKETS 64
+#define LATENCY_BUCKET_US 500 // histogram resolution, last bucket collects everything above 32 ms
+
+enum latencyStates
+{
+  latencyIdle,
+  latencyScanned,
+  latencyRendered
+};
+
+struct LatencyStats
+{
+  uint32_t count;
+  uint32_t skipped;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t sumUs;
+  uint64_t sumScanToRenderUs; // control tick quantization part of the total
+  uint32_t histogram[LATENCY_BUCKETS];
+};
+
+class LatencyTrace
+{
+public:
+  LatencyTrace() : state(latencyIdle)
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    stats.count = 0;
+    stats.skipped = 0;
+    stats.minUs = 0xFFFFFFFFUL;
+    stats.maxUs = 0;
+    stats.sumUs = 0;
+    stats.sumScanToRenderUs = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+      stats.histogram[i] = 0;
+    }
+  }
+
+  // Returns false when the event is not traced because another one is in flight
+  bool scanned(uint32_t now_us)
+  {
+    if (state != latencyIdle)
+    {
+      stats.skipped++;
+      return false;
+    }
+    scanTime = now_us;
+    state = latencyScanned;
+    return true;
+  }
+
+  inline AUDIO_HOT void rendered(uint32_t sample_index, uint32_t now_us)
+  {
+    if (state == latencyScanned)
+    {
+      renderIndex = sample_index;
+      renderTime = now_us;
+      state = latencyRendered;
+    }
+  }
+
+  // Returns true when the traced sample has just left, i.e. the event is complete
+  inline AUDIO_HOT bool output(uint32_t sample_index, uint32_t now_us)
+  {
+    if (state != latencyRendered || (int32_t)(sample_index - renderIndex) < 0)
+      return false;
+    uint32_t total = now_us - scanTime;
+    stats.count++;
+    stats.sumUs += total;
+    stats.sumScanToRenderUs += renderTime - scanTime;
+    if (total < stats.minUs)
+      stats.minUs = total;
+    if (total > stats.maxUs)
+      stats.maxUs = total;
+    uint32_t bucket = total / LATENCY_BUCKET_US;
+    stats.histogram[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1]++;
+    state = latencyIdle;
+    return true;
+  }
+
+  uint8_t getState() const
+  {
+    return state;
+  }
+
+  const LatencyStats &getStats() const
+  {
+    return stats;
+  }
+
+  // Smallest latency below which the given per mille of events fall, from the histogram
+  uint32_t percentileUs(uint16_t per_mille) const
+  {
+    uint32_t wanted = (uint32_t)(((uint64_t)stats.count * per_mille + 999) / 1000);
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+      seen += stats.histogram[i];
+      if (seen >= wanted && seen > 0)
+        return (uint32_t)(i + 1) * LATENCY_BUCKET_US;
+    }
+    return (uint32_t)LATENCY_BUCKETS * LATENCY_BUCKET_US;
+  }
+
+private:
+  volatile uint8_t state;
+  uint32_t scanTime;
+  uint32_t renderTime;
+  volatile uint32_t renderIndex;
+  LatencyStats stats;
+};
+
+#endif /* LATENCYTRACE_H */
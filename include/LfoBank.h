@@ -0,0 +1,264 @@
+#ifndef LFOBANK_H
+#define LFOBANK_H
+
+#include <stdint.h>
+
+/*  Bank of N control rate LFOs, evaluated once per control block.
+
+    Each LFO has a 32 bit phase (one cycle = 2^32) advanced by update(),
+    so the rate is fixed point: millihertz, from LFO_MIN_RATE (a 17 minute
+    cycle) up to just below half the control rate. Instead of a free rate an
+    LFO can follow the sequencer tempo in note divisions (lfoSyncs).
+    Shapes are the four 2048 cell tables of the old LFO1 / LFO2 Oscils plus
+    smooth random (a new random target every cycle, approached linearly)
+    and sample & hold (a new random value every cycle). Values are -128..127
+    like Oscil::next() on an int8 table, so the modulation amounts keep
+    their meaning.
+
+    Retriggered LFOs restart from their phase offset on noteOn(), synced
+    ones on restartSynced() (sequencer start). The phase offset also shifts
+    free running LFOs against each other.
+*/
+
+#define LFO_TABLE_CELLS 2048
+#define LFO_TABLE_SHAPES 4
+#define LFO_MIN_RATE 1 // mHz
+
+enum lfoShapes
+{
+  lfoSine,
+  lfoSaw,
+  lfoSquare,
+  lfoTriangle,
+  lfoSmoothRandom,
+  lfoSampleHold,
+  numLfoShapes
+};
+
+enum lfoSyncs
+{
+  lfoFree,
+  lfoSync4Bars,
+  lfoSync2Bars,
+  lfoSyncBar,
+  lfoSyncHalf,
+  lfoSyncQuarter,
+  lfoSyncEighth,
+  lfoSyncSixteenth,
+  lfoSyncEighthTriplet,
+  lfoSyncSixteenthTriplet,
+  numLfoSyncs
+};
+
+template <uint8_t N>
+class LfoBank
+{
+public:
+  LfoBank() : controlRate(256), tempo(1200), random(0x9E3779B9UL)
+  {
+    for (uint8_t s = 0; s < LFO_TABLE_SHAPES; s++)
+      tables[s] = 0;
+    for (uint8_t i = 0; i < N; i++)
+    {
+      Lfo &l = lfos[i];
+      l.phase = 0;
+      l.rate = 100;
+      l.shape = lfoSine;
+      l.sync = lfoFree;
+      l.offset = 0;
+      l.state = false;
+      l.retrigger = false;
+      l.value = 0;
+      l.from = l.to = 0;
+      setIncrement(l);
+    }
+  }
+
+  uint8_t size() const
+  {
+    return N;
+  }
+
+  // Table for lfoSine .. lfoTriangle, LFO_TABLE_CELLS cells, shared by all LFOs
+  void setTable(uint8_t shape, const int8_t *table)
+  {
+    if (shape < LFO_TABLE_SHAPES)
+      tables[shape] = table;
+  }
+
+  void setRates(uint16_t control_rate)
+  {
+    controlRate = control_rate ? control_rate : 1;
+    for (uint8_t i = 0; i < N; i++)
+      setIncrement(lfos[i]);
+  }
+
+  // Sequencer tempo in 0.1 BPM
+  void setTempo(uint16_t tempo_10)
+  {
+    tempo = tempo_10 ? tempo_10 : 1;
+    for (uint8_t i = 0; i < N; i++)
+    {
+      if (lfos[i].sync != lfoFree)
+        setIncrement(lfos[i]);
+    }
+  }
+
+  // Only routes the LFO, it keeps running while off
+  void setState(uint8_t i, bool on)
+  {
+    if (i < N)
+      lfos[i].state = on;
+  }
+
+  bool getState(uint8_t i) const
+  {
+    return i < N && lfos[i].state;
+  }
+
+  void setShape(uint8_t i, uint8_t shape)
+  {
+    if (i < N && shape < numLfoShapes)
+      lfos[i].shape = shape;
+  }
+
+  void setRate(uint8_t i, uint32_t millihertz)
+  {
+    if (i >= N)
+      return;
+    lfos[i].rate = millihertz < LFO_MIN_RATE ? LFO_MIN_RATE : millihertz;
+    setIncrement(lfos[i]);
+  }
+
+  void setSync(uint8_t i, uint8_t sync)
+  {
+    if (i >= N || sync >= numLfoSyncs)
+      return;
+    lfos[i].sync = sync;
+    setIncrement(lfos[i]);
+  }
+
+  void setRetrigger(uint8_t i, bool on)
+  {
+    if (i < N)
+      lfos[i].retrigger = on;
+  }
+
+  // in 1/256 of a cycle
+  void setPhaseOffset(uint8_t i, uint8_t offset)
+  {
+    if (i < N)
+      lfos[i].offset = offset;
+  }
+
+  void noteOn()
+  {
+    for (uint8_t i = 0; i < N; i++)
+    {
+      if (lfos[i].retrigger)
+        restart(lfos[i]);
+    }
+  }
+
+  void restartSynced()
+  {
+    for (uint8_t i = 0; i < N; i++)
+    {
+      if (lfos[i].sync != lfoFree)
+        restart(lfos[i]);
+    }
+  }
+
+  // One control block
+  void update()
+  {
+    for (uint8_t i = 0; i < N; i++)
+    {
+      Lfo &l = lfos[i];
+      uint32_t last = l.phase;
+      l.phase += l.increment;
+      bool wrapped = l.phase < last;
+      uint32_t p = l.phase + ((uint32_t)l.offset << 24);
+      switch (l.shape)
+      {
+      case lfoSmoothRandom:
+        if (wrapped)
+        {
+          l.from = l.to;
+          l.to = nextRandom();
+        }
+        l.value = l.from + (((l.to - l.from) * (int32_t)(l.phase >> 16)) >> 16);
+        break;
+      case lfoSampleHold:
+        if (wrapped)
+          l.to = nextRandom();
+        l.value = l.to;
+        break;
+      default:
+        l.value = tables[l.shape] ? tables[l.shape][p >> 21] : 0;
+        break;
+      }
+    }
+  }
+
+  int8_t value(uint8_t i) const
+  {
+    return lfos[i].value;
+  }
+
+private:
+  struct Lfo
+  {
+    uint32_t phase;
+    uint32_t increment; // per control block
+    uint32_t rate;      // mHz while free running
+    uint8_t shape;
+    uint8_t sync;
+    uint8_t offset;
+    bool state;
+    bool retrigger;
+    int8_t value;
+    int16_t from;
+    int16_t to;
+  };
+
+  Lfo lfos[N];
+  const int8_t *tables[LFO_TABLE_SHAPES];
+  uint16_t controlRate;
+  uint16_t tempo;
+  uint32_t random;
+
+  void setIncrement(Lfo &l)
+  {
+    // cycle length of the divisions in 1/12 beats, 12 = a quarter note
+    static const uint16_t syncTwelfths[numLfoSyncs] = {0, 192, 96, 48, 24, 12, 6, 3, 4, 2};
+    uint64_t increment;
+    if (l.sync == lfoFree)
+      increment = ((uint64_t)l.rate << 32) / (1000ULL * controlRate);
+    else // tempo / 600 beats per second, 12 / twelfths cycles per beat
+      increment = (((uint64_t)tempo * 12) << 32) / (600ULL * syncTwelfths[l.sync] * controlRate);
+    l.increment = increment > 0x7FFFFFFFULL ? 0x7FFFFFFFUL : (uint32_t)increment; // below half the control rate
+    if (l.increment == 0)
+      l.increment = 1;
+  }
+
+  void restart(Lfo &l)
+  {
+    l.phase = 0;
+    if (l.shape >= lfoSmoothRandom)
+    {
+      l.from = l.to;
+      l.to = nextRandom();
+    }
+  }
+
+  int8_t nextRandom()
+  {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    return (int8_t)(random >> 24);
+  }
+};
+
+#endif /* LFOBANK_H */
@@ -0,0 +1,66 @@
+#ifndef MULTIFILTER_H
+#define MULTIFILTER_H
+
+#include <stdint.h>
+#include "HotPath.h"
+
+/*  Resonant two-pole filter with lowpass, bandpass, highpass and notch taps.
+
+    The arithmetic of Mozzi's MultiResonantFilter<uint8_t> on 32 bit
+    samples: cutoff and resonance are 0..255, the feedback is
+    resonance + resonance * (255 - cutoff) / 256, and next() advances both
+    buffers once, after which all four outputs can be read.
+    At half rate the caller runs next() every other sample and holds the
+    outputs in between; the cutoff coefficient is doubled to keep the
+    corner roughly in place. The buffers keep running either way, so
+    switching back needs no reset.
+*/
+
+class MultiFilter
+{
+public:
+  MultiFilter() : cutoff(0), halfRate(false), f(0), q(0), fb(0), buf0(0), buf1(0), lastIn(0) {}
+
+  void setCutoffFreqAndResonance(uint8_t cutoff_value, uint8_t resonance)
+  {
+    cutoff = cutoff_value;
+    f = halfRate ? (cutoff < 128 ? cutoff << 1 : 255) : cutoff;
+    q = resonance;
+    fb = q + (((uint16_t)q * (uint16_t)(255 - f)) >> 8);
+  }
+
+  void setHalfRate(bool half)
+  {
+    halfRate = half;
+    setCutoffFreqAndResonance(cutoff, q);
+  }
+
+  bool getHalfRate() const
+  {
+    return halfRate;
+  }
+
+  inline AUDIO_HOT void next(int32_t in)
+  {
+    lastIn = in;
+    buf0 += (int32_t)(((int64_t)((in - buf0) + (((int64_t)fb * (buf0 - buf1)) >> 8)) * f) >> 8);
+    buf1 += ((buf0 - buf1) * f) >> 8;
+  }
+
+  inline int32_t low() const { return buf1; }
+  inline int32_t high() const { return lastIn - buf0; }
+  inline int32_t band() const { return buf0 - buf1; }
+  inline int32_t notch() const { return lastIn - buf0 + buf1; }
+
+private:
+  uint8_t cutoff; // as set, f is the coefficient in use
+  bool halfRate;
+  uint8_t f;
+  uint8_t q;
+  uint16_t fb;
+  int32_t buf0;
+  int32_t buf1;
+  int32_t lastIn;
+};
+
+#endif /* MULTIFILTER_H */
@@ -0,0 +1,258 @@
+#ifndef NOISESOURCE_H
+#define NOISESOURCE_H
+
+#include <stdint.h>
+#include "HotPath.h"
+
+/*  Procedural noise source, used instead of looping the WHITENOISE8192 table.
+
+    White noise comes from a 32 bit xorshift, pink noise from a
+    Voss-McCartney stack (7 rows + 1 white term), sample-and-hold holds a
+    random value for "rate" calls and crackle fires sparse random impulses
+    on average every "rate" calls.
+    Output is signed 8 bit like the Mozzi int8 tables, so it can replace
+    noise.next() without touching the mix scaling. The audio path renders
+    NOISE_BLOCK samples at a time with fill() (see NoiseBlock), which gets
+    more out of each xorshift step than next(): four white samples, or a
+    pair of pink samples (row 0 on the first, a higher row on the second).
+    On the host (tools/bench.cpp) block white noise costs about 1.5 times
+    the old table lookup and half of next(); block pink noise costs about
+    as much as next(), around three table lookups, as its row bookkeeping
+    is per sample either way. The block streams are the same kinds of
+    noise as next()'s but not the same samples. Sample-and-hold and
+    crackle are the same either way.
+*/
+
+#define NOISE_PINK_ROWS 7
+#define NOISE_BLOCK 64
+
+enum noiseTypes
+{
+  whiteNoise,
+  pinkNoise,
+  sampleHoldNoise,
+  crackleNoise
+};
+
+class NoiseSource
+{
+public:
+  NoiseSource() : state(0x9E3779B9UL), type(whiteNoise), rate(64), holdCount(0), holdValue(0), pinkCounter(0), pinkSum(0)
+  {
+    for (uint8_t i = 0; i < NOISE_PINK_ROWS; i++)
+    {
+      pinkRows[i] = 0;
+    }
+    setRate(rate);
+  }
+
+  void seed(uint32_t s)
+  {
+    state = s ? s : 0x9E3779B9UL; // xorshift must never be seeded with 0
+  }
+
+  void setType(uint8_t t)
+  {
+    if (t <= crackleNoise)
+      type = t;
+  }
+
+  uint8_t getType() const
+  {
+    return type;
+  }
+
+  // Hold length for sample-and-hold, mean impulse spacing for crackle (in calls of next())
+  void setRate(uint16_t calls)
+  {
+    if (calls == 0)
+      calls = 1;
+    rate = calls;
+    crackleThreshold = 0xFFFFFFFFUL / calls;
+  }
+
+  inline AUDIO_HOT int8_t next()
+  {
+    switch (type)
+    {
+    case pinkNoise:
+      return nextPink();
+    case sampleHoldNoise:
+      return nextHold();
+    case crackleNoise:
+      return nextCrackle();
+    default:
+      return (int8_t)(xorshift() >> 24);
+    }
+  }
+
+  // Block version of next(), the type switch is done once per call. White and pink
+  // noise run fastest for n a multiple of 4.
+  AUDIO_HOT void fill(int8_t *buf, uint16_t n)
+  {
+    switch (type)
+    {
+    case pinkNoise:
+      fillPink(buf, n);
+      break;
+    case sampleHoldNoise:
+      for (uint16_t i = 0; i < n; i++)
+        buf[i] = nextHold();
+      break;
+    case crackleNoise:
+      for (uint16_t i = 0; i < n; i++)
+        buf[i] = nextCrackle();
+      break;
+    default:
+      fillWhite(buf, n);
+      break;
+    }
+  }
+
+private:
+  uint32_t state;
+  uint32_t crackleThreshold;
+  uint8_t type;
+  uint16_t rate;
+  uint16_t holdCount;
+  int8_t holdValue;
+  uint8_t pinkCounter;
+  int16_t pinkSum;
+  int8_t pinkRows[NOISE_PINK_ROWS];
+
+  inline uint32_t xorshift()
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  // Each call replaces the row given by the trailing zeros of a counter, so row k
+  // changes every 2^(k+1) samples; counts of 64, 128 and 0 all land on the last row.
+  // Rows are 5 bit signed, 8 terms sum into int8 range.
+  inline int8_t nextPink()
+  {
+    pinkCounter++;
+    uint8_t row = __builtin_ctz(pinkCounter | 1 << (NOISE_PINK_ROWS - 1));
+    uint32_t r = xorshift();
+    pinkSum -= pinkRows[row];
+    pinkRows[row] = (int8_t)((int32_t)r >> 27);
+    pinkSum += pinkRows[row];
+    return (int8_t)(pinkSum + ((int32_t)(r << 5) >> 27));
+  }
+
+  // Four samples per xorshift step, one per byte. The state is kept in a local,
+  // buf stores could alias the members.
+  inline void fillWhite(int8_t *buf, uint16_t n)
+  {
+    uint32_t r = state;
+    uint16_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+      r ^= r << 13;
+      r ^= r >> 17;
+      r ^= r << 5;
+      buf[i] = (int8_t)(r >> 24);
+      buf[i + 1] = (int8_t)(r >> 16);
+      buf[i + 2] = (int8_t)(r >> 8);
+      buf[i + 3] = (int8_t)r;
+    }
+    state = r;
+    for (; i < n; i++)
+      buf[i] = (int8_t)(xorshift() >> 24);
+  }
+
+  // nextPink() a pair at a time from one xorshift step: the odd count always
+  // replaces row 0, so it stays in a register, the even count replaces row 1 and up.
+  // Rows and state are copied to locals like in fillWhite().
+  inline void fillPink(int8_t *buf, uint16_t n)
+  {
+    uint16_t i = 0;
+    if ((pinkCounter & 1) && n) // left odd by the tail of an odd n
+      buf[i++] = nextPink();
+    int32_t rows[NOISE_PINK_ROWS];
+    for (uint8_t k = 0; k < NOISE_PINK_ROWS; k++)
+      rows[k] = pinkRows[k];
+    uint32_t r = state;
+    int32_t sum = pinkSum;
+    int32_t row0 = rows[0];
+    uint8_t counter = pinkCounter;
+    for (; i + 2 <= n; i += 2)
+    {
+      r ^= r << 13;
+      r ^= r >> 17;
+      r ^= r << 5;
+      int32_t v = (int32_t)r >> 27;
+      sum += v - row0;
+      row0 = v;
+      buf[i] = (int8_t)(sum + ((int32_t)(r << 5) >> 27));
+      counter += 2;
+      uint8_t row = __builtin_ctz(counter | 1 << (NOISE_PINK_ROWS - 1));
+      v = (int32_t)(r << 10) >> 27;
+      sum += v - rows[row];
+      rows[row] = v;
+      buf[i + 1] = (int8_t)(sum + ((int32_t)(r << 15) >> 27));
+    }
+    rows[0] = row0;
+    for (uint8_t k = 0; k < NOISE_PINK_ROWS; k++)
+      pinkRows[k] = (int8_t)rows[k];
+    state = r;
+    pinkSum = (int16_t)sum;
+    pinkCounter = counter;
+    if (i < n)
+      buf[i] = nextPink();
+  }
+
+  inline int8_t nextHold()
+  {
+    if (holdCount == 0)
+    {
+      holdCount = rate;
+      holdValue = (int8_t)(xorshift() >> 24);
+    }
+    holdCount--;
+    return holdValue;
+  }
+
+  inline int8_t nextCrackle()
+  {
+    uint32_t r = xorshift();
+    if (r < crackleThreshold)
+    {
+      return (int8_t)(xorshift() >> 24);
+    }
+    return 0;
+  }
+};
+
+// Audio noise read one sample at a time from blocks rendered by fill()
+class NoiseBlock
+{
+public:
+  NoiseBlock() : position(NOISE_BLOCK)
+  {
+  }
+
+  NoiseSource &source()
+  {
+    return noise;
+  }
+
+  inline AUDIO_HOT int8_t next()
+  {
+    if (position == NOISE_BLOCK)
+    {
+      noise.fill(buffer, NOISE_BLOCK);
+      position = 0;
+    }
+    return buffer[position++];
+  }
+
+private:
+  NoiseSource noise;
+  int8_t buffer[NOISE_BLOCK];
+  uint8_t position;
+};
+
+#endif /* NOISESOURCE_H */
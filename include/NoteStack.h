@@ -0,0 +1,169 @@
+#ifndef NOTESTACK_H
+#define NOTESTACK_H
+
+#include <stdint.h>
+
+/*  Held notes of the mono voice, with last, low or high note priority.
+
+    Notes are 0..NOTE_STACK_SIZE-1 in pitch order, so the held notes are
+    one bit each in a 32 bit mask: low and high priority are the lowest and
+    highest set bit (count trailing / leading zeros). Last note priority
+    keeps the press order in a doubly linked list over the same 32 slots.
+    push() and remove() are constant time whatever is held, and a released
+    note falls back to the next one by the priority, still held.
+
+    update() takes the whole key mask of a scan and applies only the bits
+    that changed, releases before presses (presses of one scan count as
+    pressed from low to high). follow() then tells the voice what to do
+    with the note the priority picks: start it (envelopes retriggered),
+    glide to it (legato, only while another note was sounding), stop, or
+    nothing when the sounding note did not change.
+*/
+
+#define NOTE_STACK_SIZE 32
+#define NOTE_NONE -1
+
+enum notePriorities
+{
+  priorityLast,
+  priorityLow,
+  priorityHigh
+};
+
+enum noteActions
+{
+  noteKeep,
+  noteStart,
+  noteGlide,
+  noteStop
+};
+
+class NoteStack
+{
+public:
+  NoteStack() : priority(priorityLast)
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    held = 0;
+    top = NOTE_NONE;
+    playing = NOTE_NONE;
+    count = 0;
+  }
+
+  void setPriority(uint8_t p)
+  {
+    priority = p <= priorityHigh ? p : (uint8_t)priorityLast;
+  }
+
+  uint8_t getPriority() const
+  {
+    return priority;
+  }
+
+  void push(uint8_t note)
+  {
+    if (note >= NOTE_STACK_SIZE || (held & (1UL << note)))
+      return;
+    held |= 1UL << note;
+    below[note] = top;
+    above[note] = NOTE_NONE;
+    if (top != NOTE_NONE)
+      above[top] = note;
+    top = note;
+    count++;
+  }
+
+  void remove(uint8_t note)
+  {
+    if (note >= NOTE_STACK_SIZE || !(held & (1UL << note)))
+      return;
+    held &= ~(1UL << note);
+    if (below[note] != NOTE_NONE)
+      above[below[note]] = above[note];
+    if (above[note] != NOTE_NONE)
+      below[above[note]] = below[note];
+    else
+      top = below[note];
+    count--;
+  }
+
+  // Applies the changes to keys, bit n = note n
+  void update(uint32_t keys)
+  {
+    uint32_t released = held & ~keys;
+    uint32_t pressed = keys & ~held;
+    while (released)
+    {
+      remove(__builtin_ctz(released));
+      released &= released - 1;
+    }
+    while (pressed)
+    {
+      push(__builtin_ctz(pressed));
+      pressed &= pressed - 1;
+    }
+  }
+
+  // The note to play, NOTE_NONE when nothing is held
+  int8_t current() const
+  {
+    if (!held)
+      return NOTE_NONE;
+    switch (priority)
+    {
+    case priorityLow:
+      return __builtin_ctz(held);
+    case priorityHigh:
+      return 31 - __builtin_clz(held);
+    default:
+      return top;
+    }
+  }
+
+  // Call after update() or setPriority(), afterwards current() is the sounding note
+  uint8_t follow(bool legato)
+  {
+    int8_t note = current();
+    if (note == playing)
+      return noteKeep;
+    uint8_t action = note == NOTE_NONE ? noteStop : (playing != NOTE_NONE && legato ? noteGlide : noteStart);
+    playing = note;
+    return action;
+  }
+
+  // The voice was taken over (sequencer), the next follow() starts a note
+  void silence()
+  {
+    playing = NOTE_NONE;
+  }
+
+  int8_t sounding() const
+  {
+    return playing;
+  }
+
+  uint32_t mask() const
+  {
+    return held;
+  }
+
+  uint8_t size() const
+  {
+    return count;
+  }
+
+private:
+  uint32_t held;
+  int8_t below[NOTE_STACK_SIZE]; // pressed before, NOTE_NONE at the bottom
+  int8_t above[NOTE_STACK_SIZE]; // pressed after, NOTE_NONE at the top
+  int8_t top;                    // last pressed
+  int8_t playing;                // note of the last follow()
+  uint8_t count;
+  uint8_t priority;
+};
+
+#endif /* NOTESTACK_H */
@@ -0,0 +1,179 @@
+#ifndef PARAMSMOOTHER_H
+#define PARAMSMOOTHER_H
+
+#include <stdint.h>
+#include <math.h>
+#include "HotPath.h"
+
+/*  Audio rate smoothing of a control rate parameter.
+
+    setTarget() takes the new value once per control tick. next() runs once
+    every SMOOTH_STEP audio samples and returns the smoothed value, so a
+    parameter moves in small steps at audio rate / SMOOTH_STEP instead of
+    one jump per control block. Linear ramps to the target over the
+    smoothing time (at least one block, so the ramp of one block ends where
+    the next one starts), one-pole approaches it with the smoothing time as
+    time constant. Values are integers, kept in 16.16 internally.
+    advanceBlock() moves a whole block at once for values the caller ramps
+    itself, like the oscillator levels in the voice gain. Once the target
+    is reached both only test a counter, and the caller tests moving() to
+    skip the work that depends on the value.
+    Smoothing is not free: a moving filter cutoff recomputes the filter
+    coefficients every SMOOTH_STEP samples. At 64 Hz with smoothing the
+    whole render still costs less than at 256 Hz without it
+    (tools/smoothing_check.cpp prints both).
+*/
+
+#define SMOOTH_STEP 8 // samples per next(), 4 kHz steps at 32768 Hz
+
+enum smoothModes
+{
+  smoothOff,
+  smoothLinear,
+  smoothOnePole
+};
+
+class ParamSmoother
+{
+public:
+  ParamSmoother()
+      : current(0), target(0), step(0), remaining(0), rampSamples(128), coefficient(65536), blockCoefficient(65536),
+        audioRate(32768), blockSize(128), time(0), mode(smoothLinear)
+  {
+    update();
+  }
+
+  void setRates(uint32_t audio_rate, uint16_t block_size)
+  {
+    audioRate = audio_rate;
+    blockSize = block_size ? block_size : 1;
+    update();
+  }
+
+  void setMode(uint8_t m)
+  {
+    mode = m <= smoothOnePole ? m : (uint8_t)smoothLinear;
+    remaining = 0;
+    current = target;
+  }
+
+  // ms, 0 = one control block
+  void setTime(uint16_t ms)
+  {
+    time = ms;
+    update();
+  }
+
+  // Once per control tick
+  void setTarget(int32_t value)
+  {
+    target = value << 16;
+    switch (mode)
+    {
+    case smoothLinear:
+      step = (target - current) / (int32_t)rampSamples;
+      remaining = step ? rampSamples : 0;
+      if (!remaining)
+        current = target;
+      break;
+    case smoothOnePole:
+      remaining = current != target;
+      break;
+    default:
+      current = target;
+      remaining = 0;
+      break;
+    }
+  }
+
+  // Straight to value, no ramp (the governor dropped smoothing)
+  void jump(int32_t value)
+  {
+    target = value << 16;
+    current = target;
+    remaining = 0;
+  }
+
+  inline AUDIO_HOT bool moving() const
+  {
+    return remaining != 0;
+  }
+
+  // Once every SMOOTH_STEP samples
+  inline AUDIO_HOT int32_t next()
+  {
+    if (remaining)
+      advance(SMOOTH_STEP, coefficient);
+    return current >> 16;
+  }
+
+  // One control block at once, returns the value at its end
+  int32_t advanceBlock()
+  {
+    if (remaining)
+      advance(blockSize, blockCoefficient);
+    return current >> 16;
+  }
+
+  int32_t value() const
+  {
+    return current >> 16;
+  }
+
+private:
+  int32_t current; // 16.16
+  int32_t target;
+  int32_t step;
+  uint32_t remaining; // samples left of the linear ramp, 1 while the one-pole moves
+  uint32_t rampSamples;
+  int32_t coefficient; // one-pole over SMOOTH_STEP samples, 16 bit fraction
+  int32_t blockCoefficient; // the same over a whole block
+  uint32_t audioRate;
+  uint16_t blockSize;
+  uint16_t time;
+  uint8_t mode;
+
+  inline AUDIO_HOT void advance(uint16_t samples, int32_t c)
+  {
+    if (mode == smoothLinear)
+    {
+      if (remaining <= samples)
+      {
+        current = target;
+        remaining = 0;
+      }
+      else
+      {
+        current += step * (int32_t)samples;
+        remaining -= samples;
+      }
+    }
+    else
+    {
+      current += (int32_t)(((int64_t)(target - current) * c) / 65536);
+      if (current - target < 65536 && target - current < 65536) // less than one unit left
+      {
+        current = target;
+        remaining = 0;
+      }
+    }
+  }
+
+  // One-pole factor for the distance covered in samples
+  static int32_t onePole(float samples, float tau)
+  {
+    int32_t c = (int32_t)(65536.0f * (1.0f - expf(-samples / (tau > 1.0f ? tau : 1.0f))));
+    return c < 1 ? 1 : c;
+  }
+
+  void update()
+  {
+    uint32_t samples = (uint32_t)(((uint64_t)time * audioRate) / 1000);
+    rampSamples = samples > blockSize ? samples : blockSize;
+    float tau = time ? (float)samples : blockSize / 4.0f; // settles within the block without a time set
+    coefficient = onePole(SMOOTH_STEP, tau);
+    blockCoefficient = onePole(blockSize, tau);
+  }
+};
+
+#endif /* PARAMSMOOTHER_H */
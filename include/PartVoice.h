@@ -0,0 +1,237 @@
+#ifndef PARTVOICE_H
+#define PARTVOICE_H
+
+#include <stdint.h>
+#include <math.h>
+#include "HotPath.h"
+#include "BlockEnvelope.h"
+#include "MultiFilter.h"
+
+/*  Voice of an extra keyboard part, layered onto the main patch.
+
+    Two table oscillators (OSC 2 with its own semitone offset and fine
+    tune) under one amplitude envelope, mixed like OSC 1 + 2 of the main
+    voice, through the part's own resonant lowpass. The cutoff follows the
+    part's envelope and LFO 1 by the part's own amounts, once per block.
+    The envelope and the oscillator levels meet once per block in one gain
+    ramp per oscillator, so a sample costs the two gain multiplies and
+    nothing for the envelope; the filter only runs while the part's
+    cutoff is below 255 or modulated. next() returns the result at the
+    level of the main voice's oscillators, and the synth adds it after its
+    own distortion and filter: the parts share the keyboard, not the
+    sound of part 1. An idle part only costs the active() test.
+    Tables are 2^PART_TABLE_BITS cells like the 8192 cell Mozzi tables,
+    the phase is 32 bit so the pitch is exact to a fraction of a cent.
+    Pitch is computed in noteOn() / setNote(), never per sample. A table
+    change on a sounding part fades it out for one block first (fadeOut(),
+    silent(), fadeIn()), so the table is never swapped under a playing
+    oscillator.
+*/
+
+#define PART_TABLE_BITS 13 // 8192 cells
+
+enum partModes
+{
+  partSingle, // part 1 plays every key
+  partSplit,  // every part plays its key zone
+  partLayer   // every part plays every key
+};
+
+class PartVoice
+{
+public:
+  PartVoice()
+      : env(256), audioRate(32768), note(0), osc2Semi(0), osc2Fine(0), level1(255), level2(0), cutoff(255),
+        resonance(0), envCutoff(0), lfoCutoff(0), filtered(false), muted(false), faded(false)
+  {
+    for (uint8_t i = 0; i < 2; i++)
+    {
+      tables[i] = 0;
+      phases[i] = 0;
+      increments[i] = 0;
+    }
+    env.setLevels(255, 255, 100, 0);
+    env.setTimes(20, 500, 5000, 50);
+  }
+
+  void setRates(uint16_t control_rate, uint32_t audio_rate)
+  {
+    audioRate = audio_rate;
+    env.setRate(control_rate);
+    gains[0].setBlockSize(audio_rate / control_rate);
+    gains[1].setBlockSize(audio_rate / control_rate);
+    setPitch();
+  }
+
+  void setTable(uint8_t osc, const int8_t *table)
+  {
+    if (osc < 2)
+      tables[osc] = table;
+  }
+
+  void setLevel(uint8_t osc, uint8_t level)
+  {
+    if (osc == 0)
+      level1 = level;
+    else
+      level2 = level;
+  }
+
+  void setOsc2Semi(int8_t semitones)
+  {
+    osc2Semi = semitones;
+    setPitch();
+  }
+
+  // -255..255, about one semitone like OSC*_FINE
+  void setOsc2Fine(int16_t fine)
+  {
+    osc2Fine = fine;
+    setPitch();
+  }
+
+  // Lowpass 0..255, cutoff 255 with resonance 0 is no filter
+  void setCutoff(uint8_t value)
+  {
+    cutoff = value;
+  }
+
+  void setResonance(uint8_t value)
+  {
+    resonance = value;
+  }
+
+  // Cutoff modulation by the part's envelope, -255..255
+  void setEnvCutoff(int16_t amount)
+  {
+    envCutoff = amount;
+  }
+
+  // Cutoff modulation by LFO 1, -255..255
+  void setLfoCutoff(int16_t amount)
+  {
+    lfoCutoff = amount;
+  }
+
+  // The next update() ramps the part to silence, silent() is true once that block has been rendered
+  void fadeOut()
+  {
+    muted = true;
+  }
+
+  bool silent() const
+  {
+    return faded;
+  }
+
+  void fadeIn()
+  {
+    muted = false;
+    faded = false;
+  }
+
+  BlockEnvelope &envelope()
+  {
+    return env;
+  }
+
+  // MIDI note, octave offsets already applied
+  void noteOn(uint8_t midi_note)
+  {
+    setNote(midi_note);
+    env.noteOn();
+  }
+
+  // Legato: new pitch, envelope keeps running
+  void setNote(uint8_t midi_note)
+  {
+    note = midi_note;
+    setPitch();
+  }
+
+  void noteOff()
+  {
+    env.noteOff();
+  }
+
+  // A held note fades back in after the part was skipped
+  void restart()
+  {
+    if (env.getPhase() < envRelease)
+      env.restart();
+    else
+      env.noteOff();
+  }
+
+  bool active() const
+  {
+    return env.playing() && tables[0] && tables[1];
+  }
+
+  // One control block, lfo is LFO 1 at -128..127
+  void update(int lfo)
+  {
+    faded = muted;
+    env.update();
+    int32_t level = muted ? 0 : env.value();
+    gains[0].to((level * level1) >> 8);
+    gains[1].to((level * level2) >> 8);
+    int c = cutoff + ((((int)env.value() >> 8) * envCutoff) >> 8) + ((lfo * lfoCutoff) >> 7);
+    c = c < 0 ? 0 : (c > 255 ? 255 : c);
+    filtered = c < 255 || resonance;
+    filter.setCutoffFreqAndResonance(c, resonance);
+  }
+
+  inline AUDIO_HOT int next()
+  {
+    phases[0] += increments[0];
+    phases[1] += increments[1];
+    int mix = tables[0][phases[0] >> (32 - PART_TABLE_BITS)] * gains[0].next() +
+              tables[1][phases[1] >> (32 - PART_TABLE_BITS)] * gains[1].next();
+    int out = ((mix >> 8) * 3) >> 3;
+    if (filtered)
+    {
+      filter.next(out);
+      out = filter.low();
+    }
+    return out;
+  }
+
+private:
+  BlockEnvelope env;
+  GainRamp gains[2]; // envelope * level
+  MultiFilter filter;
+  const int8_t *tables[2];
+  uint32_t phases[2];
+  uint32_t increments[2];
+  uint32_t audioRate;
+  uint8_t note;
+  int8_t osc2Semi;
+  int16_t osc2Fine;
+  uint8_t level1;
+  uint8_t level2;
+  uint8_t cutoff;
+  uint8_t resonance;
+  int16_t envCutoff;
+  int16_t lfoCutoff;
+  bool filtered; // cutoff below 255 or resonance set this block
+  bool muted;    // fading out for a table change
+  bool faded;    // the last block ramped to silence
+
+  void setPitch()
+  {
+    float hz1 = 440.0f * powf(2.0f, (note - 69) / 12.0f);
+    float hz2 = 440.0f * powf(2.0f, (note + osc2Semi - 69) / 12.0f);
+    hz2 += osc2Fine > 0 ? 0.0595f * hz2 * osc2Fine / 255 : 0.0561f * hz2 * osc2Fine / 255; // like detune()
+    increments[0] = increment(hz1);
+    increments[1] = increment(hz2);
+  }
+
+  uint32_t increment(float hz) const
+  {
+    float cycles = hz / audioRate;
+    return (uint32_t)((cycles < 0.5f ? cycles : 0.5f) * 4294967296.0f);
+  }
+};
+
+#endif /* PARTVOICE_H */
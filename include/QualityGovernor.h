@@ -0,0 +1,137 @@
+#ifndef QUALITYGOVERNOR_H
+#define QUALITYGOVERNOR_H
+
+#include <stdint.h>
+#include "HotPath.h"
+
+/*  Load-adaptive quality governor.
+
+    Fed once per block with the time spent rendering that block and the
+    time the block lasts (any unit, e.g. CPU cycles). When the smoothed load
+    stays above the high mark, or a block misses its deadline, the quality
+    level steps down one rung; when the load stays below the low mark long
+    enough it steps back up. A step down shortly after a step up doubles the
+    recovery wait, so a patch sitting right at the limit does not toggle.
+    The decision logic has no hardware dependency and can be driven with
+    synthetic load traces.
+*/
+
+// Rungs in the order they are given up, the least audible loss first. A feature is
+// allowed while level() is below its rung.
+enum qualityLevels
+{
+  qualityFull,
+  qualityNoParts,         // keyboard parts beyond part 1 fall silent, held ones restart on recovery
+  qualityNoSampleVoice,   // sample voice stopped, the next note starts it again
+  qualityWhiteNoise,      // noise plays white whatever NOISE_TYPE says
+  qualityHalfRateFilter,  // filter runs every other sample at doubled cutoff
+  qualityNoSmoothing,     // modulated parameters step once per control block
+  numQualityLevels
+};
+
+class QualityGovernor
+{
+public:
+  QualityGovernor() : level(qualityFull), load(0), overBlocks(0), underBlocks(0), sinceUp(0xFFFF)
+  {
+    setThresholds(218, 154); // 85 % and 60 % of the block time
+    setTimes(2, 256);
+  }
+
+  // Load marks in 1/256 of the block time
+  void setThresholds(uint16_t high, uint16_t low)
+  {
+    highMark = high;
+    lowMark = low;
+  }
+
+  // Blocks over the high mark before stepping down, blocks under the low mark before stepping up
+  void setTimes(uint16_t down_blocks, uint16_t up_blocks)
+  {
+    downBlocks = down_blocks;
+    upBlocks = up_blocks;
+    recoverBlocks = up_blocks;
+  }
+
+  // Returns true when the level changed
+  bool update(uint32_t render_time, uint32_t block_time)
+  {
+    if (block_time == 0)
+      return false;
+    uint64_t scaled = ((uint64_t)render_time << 8) / block_time;
+    uint16_t blockLoad = scaled > 0xFFFF ? 0xFFFF : (uint16_t)scaled;
+    load += ((int32_t)blockLoad - (int32_t)load) >> 2;
+    if (sinceUp < 0xFFFF)
+      sinceUp++;
+
+    if (blockLoad >= 256 || load > highMark)
+    {
+      underBlocks = 0;
+      if (++overBlocks >= downBlocks && level < numQualityLevels - 1)
+      {
+        if (sinceUp < recoverBlocks && recoverBlocks < 0x4000)
+          recoverBlocks <<= 1;
+        level++;
+        overBlocks = 0;
+        return true;
+      }
+    }
+    else if (load < lowMark)
+    {
+      overBlocks = 0;
+      if (++underBlocks >= recoverBlocks && level > qualityFull)
+      {
+        level--;
+        underBlocks = 0;
+        sinceUp = 0;
+        return true;
+      }
+    }
+    else
+    {
+      overBlocks = 0;
+      underBlocks = 0;
+    }
+    return false;
+  }
+
+  inline AUDIO_HOT bool allows(uint8_t rung) const
+  {
+    return level < rung;
+  }
+
+  uint8_t getLevel() const
+  {
+    return level;
+  }
+
+  // Smoothed load in percent of the block time
+  uint16_t getLoad() const
+  {
+    return (uint16_t)(((uint32_t)load * 100) >> 8);
+  }
+
+  void reset()
+  {
+    level = qualityFull;
+    load = 0;
+    sinceUp = 0xFFFF;
+    overBlocks = 0;
+    underBlocks = 0;
+    recoverBlocks = upBlocks;
+  }
+
+private:
+  uint8_t level;
+  uint16_t load; // smoothed, 1/256 of the block time
+  uint16_t highMark;
+  uint16_t lowMark;
+  uint16_t downBlocks;
+  uint16_t upBlocks;
+  uint16_t recoverBlocks;
+  uint16_t overBlocks;
+  uint16_t underBlocks;
+  uint16_t sinceUp;
+};
+
+#endif /* QUALITYGOVERNOR_H */
@@ -0,0 +1,214 @@
+#ifndef SAMPLEVOICE_H
+#define SAMPLEVOICE_H
+
+#include <stdint.h>
+#include "HotPath.h"
+
+/*  One-shot / looped PCM sample playback from a memory mapped flash image.
+
+    The image is built by tools/pack_samples.py and flashed to the
+    "samples" data partition; the firmware maps it with
+    esp_partition_mmap() and SampleBank reads it in place, nothing is
+    copied. Layout (little endian):
+      SampleImageHeader   "SMPL", version, count, image size
+      SampleEntry[count]  offset (bytes from the image start, 4 aligned),
+                          length, loop start / end (frames), sample rate,
+                          root note, flags
+      16 bit signed mono PCM
+    Reads go through the flash cache, so a cache miss can cost a few
+    hundred cycles and a read faults while the cache is off for a flash
+    write. The synth therefore calls render() once per control block into
+    a RAM buffer, and the audio path only reads that buffer; next() is the
+    per-frame step and not IRAM resident.
+
+    SampleVoice steps through the sample with a 16.16 phase (pitch from the
+    root note and the sample / audio rate ratio, integer only) and linearly
+    interpolates between neighbouring frames. A looped sample loops between
+    loop start and loop end while the key is held and plays out to the end
+    after release().
+*/
+
+#define SAMPLE_MAGIC 0x4C504D53UL // "SMPL"
+#define SAMPLE_VERSION 1
+#define SAMPLE_LOOP 0x01         // SampleEntry flag
+#define SAMPLE_MAX_STEP (16UL << 16) // highest pitch, 4 octaves above the sample rate
+
+struct SampleImageHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  uint32_t size; // bytes of the whole image
+  uint32_t reserved;
+};
+
+struct SampleEntry
+{
+  uint32_t offset;
+  uint32_t length; // frames
+  uint32_t loopStart;
+  uint32_t loopEnd; // exclusive
+  uint32_t sampleRate;
+  uint8_t rootNote; // MIDI note played back at the sample rate
+  uint8_t flags;
+  uint16_t reserved;
+};
+
+class SampleBank
+{
+public:
+  SampleBank() : image(0), entries(0), count(0) {}
+
+  // false (and an empty bank) when the image is missing or malformed
+  bool begin(const uint8_t *img, uint32_t size)
+  {
+    image = 0;
+    entries = 0;
+    count = 0;
+    if (img == 0 || size < sizeof(SampleImageHeader))
+      return false;
+    const SampleImageHeader *header = (const SampleImageHeader *)img;
+    if (header->magic != SAMPLE_MAGIC || header->version != SAMPLE_VERSION || header->size > size ||
+        sizeof(SampleImageHeader) + (uint32_t)header->count * sizeof(SampleEntry) > header->size)
+      return false;
+    const SampleEntry *table = (const SampleEntry *)(img + sizeof(SampleImageHeader));
+    for (uint16_t i = 0; i < header->count; i++)
+    {
+      const SampleEntry &e = table[i];
+      if (e.offset % 4 || e.offset > header->size || e.length == 0 || e.length > (header->size - e.offset) / 2 ||
+          e.sampleRate == 0 || ((e.flags & SAMPLE_LOOP) && !(e.loopStart < e.loopEnd && e.loopEnd <= e.length)))
+        return false;
+    }
+    image = img;
+    entries = table;
+    count = header->count;
+    return true;
+  }
+
+  uint16_t size() const
+  {
+    return count;
+  }
+
+  const SampleEntry *entry(uint16_t index) const
+  {
+    return index < count ? &entries[index] : 0;
+  }
+
+  const int16_t *data(const SampleEntry &e) const
+  {
+    return (const int16_t *)(image + e.offset);
+  }
+
+private:
+  const uint8_t *image;
+  const SampleEntry *entries;
+  uint16_t count;
+};
+
+class SampleVoice
+{
+public:
+  SampleVoice()
+      : data(0), position(0), end(0), length(0), loopStart(0), loopEnd(0), fraction(0), step(0), playing(false),
+        looping(false)
+  {
+  }
+
+  // note and rootNote are MIDI notes, without tracking the sample plays at its own rate.
+  // start_point is in 1/256 of the length.
+  void start(const SampleBank &bank, uint16_t index, uint8_t note, bool track, uint8_t start_point, uint32_t audio_rate)
+  {
+    const SampleEntry *e = bank.entry(index);
+    if (e == 0 || audio_rate == 0)
+    {
+      playing = false;
+      return;
+    }
+    step = stepFor(*e, track ? (int)note - e->rootNote : 0, audio_rate);
+    data = bank.data(*e);
+    looping = e->flags & SAMPLE_LOOP;
+    loopStart = e->loopStart;
+    loopEnd = e->loopEnd;
+    end = looping ? loopEnd : e->length;
+    length = e->length;
+    position = (uint32_t)(((uint64_t)e->length * start_point) >> 8);
+    fraction = 0;
+    playing = position < end;
+  }
+
+  // Key released: a looped sample plays on from the loop to its end
+  void release()
+  {
+    looping = false;
+    end = length;
+  }
+
+  void stop()
+  {
+    playing = false;
+  }
+
+  bool active() const
+  {
+    return playing;
+  }
+
+  inline int16_t next()
+  {
+    if (!playing)
+      return 0;
+    int32_t s0 = data[position];
+    uint32_t n = position + 1;
+    if (n >= end)
+      n = looping ? loopStart : position; // hold the last frame
+    int32_t s1 = data[n];
+    int32_t out = s0 + (((s1 - s0) * (int32_t)(fraction >> 1)) >> 15);
+    uint32_t f = fraction + (step & 0xFFFF);
+    fraction = f & 0xFFFF;
+    position += (step >> 16) + (f >> 16);
+    if (position >= end)
+    {
+      if (looping)
+        position = loopStart + (position - end) % (loopEnd - loopStart);
+      else
+        playing = false;
+    }
+    return (int16_t)out;
+  }
+
+  // n output samples, zeros after the end
+  void render(int16_t *out, uint16_t n)
+  {
+    for (uint16_t i = 0; i < n; i++)
+      out[i] = next();
+  }
+
+  // 16.16 frames per output sample
+  static uint32_t stepFor(const SampleEntry &e, int semitones, uint32_t audio_rate)
+  {
+    static const uint32_t semitoneRatio[12] = {65536, 69433, 73562, 77936, 82570, 87480,
+                                               92682, 98193, 104032, 110218, 116772, 123715}; // 2^(k/12), 16.16
+    int octave = semitones >= 0 ? semitones / 12 : -((11 - semitones) / 12);
+    uint64_t s = ((uint64_t)e.sampleRate << 16) / audio_rate;
+    s = (s * semitoneRatio[semitones - 12 * octave]) >> 16;
+    s = octave >= 0 ? s << (octave > 8 ? 8 : octave) : s >> (-octave > 16 ? 16 : -octave);
+    if (s > SAMPLE_MAX_STEP)
+      s = SAMPLE_MAX_STEP;
+    return s ? (uint32_t)s : 1;
+  }
+
+private:
+  const int16_t *data;
+  uint32_t position; // frame
+  uint32_t end;      // loop end while looping, otherwise the length
+  uint32_t length;
+  uint32_t loopStart;
+  uint32_t loopEnd;
+  uint16_t fraction;
+  uint32_t step;
+  bool playing;
+  bool looping;
+};
+
+#endif /* SAMPLEVOICE_H */
@@ -0,0 +1,349 @@
+#ifndef SEQUENCER_H
+#define SEQUENCER_H
+
+#include <stdint.h>
+#include "HotPath.h"
+
+/*  Step clock, arpeggiator and step sequencer.
+
+    StepClock counts samples: tick() runs once per control block, before
+    the block is rendered, and adds tempo * steps per beat for each of its
+    samples to an accumulator that wraps at 60 * sample rate (tempo in 0.1
+    BPM, so 600 * sample rate). The wrap is the step, crossing gate / 8 of
+    the wrap is the gate end. Events land on the start of the block that
+    holds their sample of the ideal grid, so they are up to one block early
+    (1 ms at 1024 Hz, 4 ms at 256 Hz), but all of it is integer, so the
+    grid never drifts. With tick(1) per sample the steps are sample exact.
+    With external sync the steps come from 24 PPQN clock pulses instead and
+    the accumulator only times the gates, scaled from the measured pulse
+    interval.
+
+    SeqStep is 4 bytes, a SeqPattern of SEQ_MAX_STEPS steps 260 bytes.
+*/
+
+#define SEQ_MAX_STEPS 64
+#define SEQ_PPQN 24        // MIDI clock pulses per beat
+#define SEQ_GATE_FULL 8    // gate in eighths of a step, 8 holds until the next step
+#define SEQ_SLIDE 0x80     // gate byte flag: glide into this note without retriggering
+#define SEQ_NO_LOCK 0xFF   // lockParam of a step without parameter lock
+#define ARP_MAX_NOTES 16
+
+enum seqModes
+{
+  seqOff,
+  seqArp,
+  seqPattern
+};
+
+enum arpModes
+{
+  arpUp,
+  arpDown,
+  arpUpDown,
+  arpRandom,
+  arpAsPlayed
+};
+
+enum clockEvents
+{
+  clockStep = 1,
+  clockGateOff = 2
+};
+
+struct SeqStep
+{
+  uint8_t note;      // offset added to the transpose key
+  uint8_t gate;      // bits 0-3 gate in eighths (0 = rest), SEQ_SLIDE
+  uint8_t lockParam; // modulation destination locked for this step, SEQ_NO_LOCK for none
+  uint8_t lockValue;
+};
+
+struct SeqPattern
+{
+  uint8_t length;
+  uint8_t reserved[3];
+  SeqStep steps[SEQ_MAX_STEPS];
+};
+
+class StepClock
+{
+public:
+  StepClock() : sampleRate(32768), tempo(1200), stepsPerBeat(4), wrap(600UL * 32768), increment(4800), accumulator(0),
+                gateAt(0), gateOpen(false), external(false), pulses(0), lastPulse(0)
+  {
+  }
+
+  // tempo in 0.1 BPM, steps per beat 1..24 (4 = 16th notes)
+  void setTempo(uint32_t sample_rate, uint16_t tempo_10, uint8_t steps_per_beat)
+  {
+    sampleRate = sample_rate;
+    tempo = tempo_10 ? tempo_10 : 1;
+    stepsPerBeat = steps_per_beat ? steps_per_beat : 1;
+    wrap = 600UL * sampleRate;
+    if (!external)
+      increment = (uint32_t)tempo * stepsPerBeat;
+  }
+
+  // Internal clock, or steps from pulse() only
+  void setExternal(bool on)
+  {
+    external = on;
+    pulses = 0;
+    setTempo(sampleRate, tempo, stepsPerBeat);
+  }
+
+  // The next tick() (or the next pulse() with external sync) starts a step
+  void restart()
+  {
+    accumulator = wrap - increment;
+    gateOpen = false;
+    pulses = 0;
+  }
+
+  // Gate of the current step in eighths, SEQ_GATE_FULL keeps it open
+  void setGate(uint8_t eighths)
+  {
+    gateOpen = eighths < SEQ_GATE_FULL;
+    gateAt = (uint32_t)(((uint64_t)wrap * eighths) / SEQ_GATE_FULL);
+  }
+
+  // Events of the next samples, one control block
+  uint8_t tick(uint16_t samples)
+  {
+    uint8_t events = 0;
+    uint64_t a = accumulator + (uint64_t)increment * samples;
+    if (a >= wrap)
+    {
+      if (external)
+      {
+        a = wrap - 1; // wait for the pulse
+      }
+      else
+      {
+        a %= wrap; // steps shorter than a block merge into one
+        events |= clockStep;
+      }
+    }
+    accumulator = (uint32_t)a;
+    if (gateOpen && accumulator >= gateAt && !(events & clockStep))
+    {
+      gateOpen = false;
+      events |= clockGateOff;
+    }
+    return events;
+  }
+
+  // One 24 PPQN clock pulse at sample_index, true when it starts a step
+  bool pulse(uint32_t sample_index)
+  {
+    if (!external)
+      return false;
+    uint32_t interval = sample_index - lastPulse;
+    lastPulse = sample_index;
+    uint8_t pulsesPerStep = SEQ_PPQN / stepsPerBeat;
+    if (pulsesPerStep == 0)
+      pulsesPerStep = 1;
+    if (interval > 0 && interval < sampleRate) // gates follow the measured tempo
+      increment = wrap / ((uint32_t)interval * pulsesPerStep) + 1;
+    bool step = pulses == 0; // the first pulse after restart() is the downbeat
+    if (++pulses >= pulsesPerStep)
+      pulses = 0;
+    if (step)
+      accumulator = 0;
+    return step;
+  }
+
+  // Samples per step at the internal tempo, fractional part dropped
+  uint32_t stepSamples() const
+  {
+    return wrap / ((uint32_t)tempo * stepsPerBeat);
+  }
+
+private:
+  uint32_t sampleRate;
+  uint16_t tempo;
+  uint8_t stepsPerBeat;
+  uint32_t wrap;
+  uint32_t increment;
+  uint32_t accumulator;
+  uint32_t gateAt;
+  bool gateOpen;
+  bool external;
+  uint8_t pulses;
+  uint32_t lastPulse;
+};
+
+class Arpeggiator
+{
+public:
+  Arpeggiator() : count(0), mode(arpUp), octaves(1), position(0), random(0x6D2B79F5UL) {}
+
+  void setMode(uint8_t m)
+  {
+    mode = m;
+    reset();
+  }
+
+  void setOctaves(uint8_t o)
+  {
+    octaves = o < 1 ? 1 : o > 4 ? 4 : o;
+    reset();
+  }
+
+  void reset()
+  {
+    position = 0;
+  }
+
+  void clear()
+  {
+    count = 0;
+    reset();
+  }
+
+  void press(uint8_t note)
+  {
+    if (count == ARP_MAX_NOTES)
+      return;
+    played[count] = note;
+    uint8_t i = count++;
+    for (; i > 0 && sorted[i - 1] > note; i--) // keep sorted in step
+      sorted[i] = sorted[i - 1];
+    sorted[i] = note;
+  }
+
+  void release(uint8_t note)
+  {
+    if (!remove(played, note))
+      return;
+    remove(sorted, note);
+    count--;
+    if (count == 0)
+      reset();
+  }
+
+  uint8_t held() const
+  {
+    return count;
+  }
+
+  // Next note, -1 when no key is held
+  int16_t next()
+  {
+    if (count == 0)
+      return -1;
+    uint8_t total = count * octaves;
+    uint8_t cycle = mode == arpUpDown && total > 1 ? 2 * total - 2 : total; // up and down without repeating the ends
+    if (position >= cycle)
+      position = 0;
+    uint8_t p = position;
+    switch (mode)
+    {
+    case arpDown:
+      p = total - 1 - position;
+      break;
+    case arpUpDown:
+      p = position < total ? position : cycle - position;
+      break;
+    case arpRandom:
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      p = random % total;
+      break;
+    default:
+      break;
+    }
+    position++;
+    return noteAt(p);
+  }
+
+private:
+  uint8_t played[ARP_MAX_NOTES]; // in the order pressed
+  uint8_t sorted[ARP_MAX_NOTES];
+  uint8_t count;
+  uint8_t mode;
+  uint8_t octaves;
+  uint8_t position;
+  uint32_t random;
+
+  int16_t noteAt(uint8_t p) const
+  {
+    const uint8_t *notes = mode == arpAsPlayed ? played : sorted;
+    return notes[p % count] + 12 * (p / count);
+  }
+
+  bool remove(uint8_t *notes, uint8_t note)
+  {
+    uint8_t i = 0;
+    while (i < count && notes[i] != note)
+      i++;
+    if (i == count)
+      return false;
+    for (; i + 1 < count; i++)
+      notes[i] = notes[i + 1];
+    return true;
+  }
+};
+
+class StepSequencer
+{
+public:
+  StepSequencer() : position(0)
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    pattern.length = 16;
+    pattern.reserved[0] = pattern.reserved[1] = pattern.reserved[2] = 0;
+    for (uint8_t i = 0; i < SEQ_MAX_STEPS; i++)
+    {
+      pattern.steps[i].note = 0;
+      pattern.steps[i].gate = 4;
+      pattern.steps[i].lockParam = SEQ_NO_LOCK;
+      pattern.steps[i].lockValue = 0;
+    }
+  }
+
+  void setLength(uint8_t length)
+  {
+    pattern.length = length < 1 ? 1 : length > SEQ_MAX_STEPS ? SEQ_MAX_STEPS : length;
+  }
+
+  SeqStep &step(uint8_t index)
+  {
+    return pattern.steps[index % SEQ_MAX_STEPS];
+  }
+
+  SeqPattern &getPattern()
+  {
+    return pattern;
+  }
+
+  void reset()
+  {
+    position = 0;
+  }
+
+  // Step to play now, then moves on
+  const SeqStep &advance()
+  {
+    if (position >= pattern.length)
+      position = 0;
+    return pattern.steps[position++];
+  }
+
+  // Index of the step advance() returned last
+  uint8_t current() const
+  {
+    return position ? position - 1 : pattern.length - 1;
+  }
+
+private:
+  SeqPattern pattern;
+  uint8_t position;
+};
+
+#endif /* SEQUENCER_H */
@@ -0,0 +1,239 @@
+#ifndef SPECTRUMANALYZER_H
+#define SPECTRUMANALYZER_H
+
+#include <stdint.h>
+#include <math.h>
+#include <atomic>
+#include "HotPath.h"
+
+/*  Fixed point spectrum and scope analyzer for the GUI.
+
+    The audio path calls tap() for every output sample; every "decimation"
+    samples the average of those samples goes into one of two tap buffers
+    (the averaging doubles as a cheap anti-alias filter). A full buffer is
+    handed to the background side, which calls process() to run a Hann
+    windowed real FFT of N points (N/2 point complex radix-2 FFT plus the
+    real split, Q15 twiddles, one bit of scaling per stage) and reduce it
+    to SPECTRUM_BANDS log spaced bands of 0.5 dB steps (255 = full scale
+    sine, 0 = 127.5 dB below) and a SPECTRUM_SCOPE_POINTS point scope trace.
+    When the background side is still busy with the other buffer the
+    newest buffer is overwritten, the audio side never waits.
+*/
+
+#define SPECTRUM_BANDS 32
+#define SPECTRUM_SCOPE_POINTS 64
+
+template <uint16_t N>
+class SpectrumAnalyzer
+{
+public:
+  SpectrumAnalyzer() : fill(0), fillCount(0), decimation(2), decimationCount(0), accumulator(0), ready(-1)
+  {
+    static_assert(N >= 256 && N <= 1024 && (N & (N - 1)) == 0, "SpectrumAnalyzer size must be 256, 512 or 1024");
+    const double pi = 3.14159265358979323846;
+    for (uint16_t k = 0; k < N / 2; k++)
+    {
+      cosTable[k] = (int16_t)lrint(32767.0 * cos(2 * pi * k / N));
+      sinTable[k] = (int16_t)lrint(32767.0 * sin(2 * pi * k / N));
+    }
+    for (uint16_t n = 0; n < N; n++)
+    {
+      window[n] = (int16_t)lrint(32767.0 * 0.5 * (1.0 - cos(2 * pi * n / N)));
+    }
+    // log spaced band edges from bin 1 to N/2, every band at least one bin wide
+    uint16_t edge = 1;
+    for (uint8_t b = 0; b < SPECTRUM_BANDS; b++)
+    {
+      bandStart[b] = edge;
+      uint16_t next = (uint16_t)lrint(pow((double)(N / 2), (double)(b + 1) / SPECTRUM_BANDS));
+      edge = next > edge ? next : edge + 1;
+      if (edge > N / 2)
+        edge = N / 2;
+    }
+    bandStart[SPECTRUM_BANDS] = N / 2;
+  }
+
+  // Output samples per tap, analysed sample rate is audio rate / decimation
+  void setDecimation(uint8_t d)
+  {
+    decimation = d ? d : 1;
+  }
+
+  uint8_t getDecimation() const
+  {
+    return decimation;
+  }
+
+  inline AUDIO_HOT void tap(int16_t sample)
+  {
+    accumulator += sample;
+    if (++decimationCount < decimation)
+      return;
+    taps[fill][fillCount] = (int16_t)(accumulator / decimation);
+    accumulator = 0;
+    decimationCount = 0;
+    if (++fillCount == N)
+    {
+      fillCount = 0;
+      if (ready.load(std::memory_order_acquire) == -1)
+      {
+        ready.store(fill, std::memory_order_release);
+        fill ^= 1;
+      }
+    }
+  }
+
+  bool available() const
+  {
+    return ready.load(std::memory_order_acquire) != -1;
+  }
+
+  // Background side: analyses the handed over buffer, false when none is ready
+  bool process(uint8_t *bands, int8_t *scope)
+  {
+    int8_t buffer = ready.load(std::memory_order_acquire);
+    if (buffer == -1)
+      return false;
+    const int16_t *x = taps[buffer];
+
+    for (uint8_t p = 0; p < SPECTRUM_SCOPE_POINTS; p++)
+    {
+      scope[p] = (int8_t)(x[(uint32_t)p * N / SPECTRUM_SCOPE_POINTS] >> 8);
+    }
+    // pack even/odd samples as real/imaginary parts, windowed, with 8 bits of headroom
+    for (uint16_t n = 0; n < N / 2; n++)
+    {
+      re[n] = ((int32_t)x[2 * n] * window[2 * n]) >> 7;
+      im[n] = ((int32_t)x[2 * n + 1] * window[2 * n + 1]) >> 7;
+    }
+    ready.store(-1, std::memory_order_release);
+
+    fft();
+
+    uint8_t band = 0;
+    uint64_t peak = 0;
+    for (uint16_t k = 1; k <= N / 2; k++)
+    {
+      uint64_t power = k < N / 2 ? binPower(k) : nyquistPower();
+      if (power > peak)
+        peak = power;
+      if (k + 1 >= bandStart[band + 1] || k == N / 2)
+      {
+        bands[band] = toHalfDb(peak);
+        peak = 0;
+        if (++band == SPECTRUM_BANDS)
+          break;
+      }
+    }
+    for (; band < SPECTRUM_BANDS; band++)
+      bands[band] = 0;
+    return true;
+  }
+
+  // Lowest bin of a band, bin width is (audio rate / decimation) / N
+  uint16_t getBandStart(uint8_t band) const
+  {
+    return bandStart[band];
+  }
+
+private:
+  int16_t taps[2][N];
+  uint8_t fill;
+  uint16_t fillCount;
+  uint8_t decimation;
+  uint8_t decimationCount;
+  int32_t accumulator;
+  std::atomic<int8_t> ready; // buffer handed to process(), -1 for none
+  int16_t cosTable[N / 2];
+  int16_t sinTable[N / 2];
+  int16_t window[N];
+  uint16_t bandStart[SPECTRUM_BANDS + 1];
+  int32_t re[N / 2];
+  int32_t im[N / 2];
+
+  // In place N/2 point radix-2 decimation in time, scaled by 1/2 per stage
+  void fft()
+  {
+    const uint16_t M = N / 2;
+    for (uint16_t i = 1, j = 0; i < M; i++)
+    {
+      uint16_t bit = M >> 1;
+      for (; j & bit; bit >>= 1)
+        j ^= bit;
+      j |= bit;
+      if (i < j)
+      {
+        int32_t t = re[i];
+        re[i] = re[j];
+        re[j] = t;
+        t = im[i];
+        im[i] = im[j];
+        im[j] = t;
+      }
+    }
+    for (uint16_t len = 2; len <= M; len <<= 1)
+    {
+      uint16_t stride = N / len; // W_len^k = W_N^(k * N / len)
+      for (uint16_t i = 0; i < M; i += len)
+      {
+        for (uint16_t k = 0; k < len / 2; k++)
+        {
+          int32_t wr = cosTable[k * stride];
+          int32_t wi = -sinTable[k * stride];
+          uint16_t a = i + k;
+          uint16_t b = a + len / 2;
+          int32_t tr = (int32_t)(((int64_t)re[b] * wr - (int64_t)im[b] * wi) >> 15);
+          int32_t ti = (int32_t)(((int64_t)re[b] * wi + (int64_t)im[b] * wr) >> 15);
+          re[b] = (re[a] - tr) >> 1;
+          im[b] = (im[a] - ti) >> 1;
+          re[a] = (re[a] + tr) >> 1;
+          im[a] = (im[a] + ti) >> 1;
+        }
+      }
+    }
+  }
+
+  // |X[k]|^2 of the real N point transform from the packed N/2 point result
+  uint64_t binPower(uint16_t k) const
+  {
+    const uint16_t M = N / 2;
+    uint16_t m = (M - k) % M;
+    int32_t evenRe = (re[k] + re[m]) >> 1;
+    int32_t evenIm = (im[k] - im[m]) >> 1;
+    int32_t oddRe = (im[k] + im[m]) >> 1;
+    int32_t oddIm = (re[m] - re[k]) >> 1;
+    int32_t wr = cosTable[k];
+    int32_t wi = -sinTable[k];
+    int64_t xr = evenRe + (((int64_t)oddRe * wr - (int64_t)oddIm * wi) >> 15);
+    int64_t xi = evenIm + (((int64_t)oddRe * wi + (int64_t)oddIm * wr) >> 15);
+    return (uint64_t)(xr * xr + xi * xi);
+  }
+
+  uint64_t nyquistPower() const
+  {
+    int64_t x = re[0] - im[0];
+    return (uint64_t)(x * x);
+  }
+
+  // 0.5 dB steps, 255 for a full scale sine in one bin
+  static uint8_t toHalfDb(uint64_t power)
+  {
+    if (power == 0)
+      return 0;
+    uint8_t msb = 63 - __builtin_clzll(power);
+    uint32_t fraction = msb >= 8 ? (uint32_t)(power >> (msb - 8)) & 0xFF : (uint32_t)(power << (8 - msb)) & 0xFF;
+    int32_t log2q8 = ((int32_t)msb << 8) | fraction;   // linear interpolated log2, Q8
+    int32_t halfDb = (log2q8 * 1541) >> 16;            // * 2 * 10 * log10(2) / 256
+    int32_t value = 255 + halfDb - fullScaleHalfDb();
+    return value < 0 ? 0 : value > 255 ? 255 : (uint8_t)value;
+  }
+
+  // Full scale sine: amplitude 32767 << 8 times the Hann coherent gain 0.5 times N / 2,
+  // divided by N / 2 from the stage scaling
+  static int32_t fullScaleHalfDb()
+  {
+    return (int32_t)(2.0 * 10.0 * log10(pow(32767.0 * 256.0 * 0.5, 2.0)) + 0.5);
+  }
+};
+
+#endif /* SPECTRUMANALYZER_H */
@@ -0,0 +1,1356 @@
+#ifndef SYNTHENGINE_H
+#define SYNTHENGINE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "HotPath.h"
+#include "SynthRates.h"
+#include "SynthParams.h"
+#include "TableOsc.h"
+#include "Glide.h"
+#include "MultiFilter.h"
+#include "Distortion.h"
+#include "NoiseSource.h"
+#include "BlockEnvelope.h"
+#include "QualityGovernor.h"
+#include "AutomationStream.h"
+#include "Sequencer.h"
+#include "SampleVoice.h"
+#include "LfoBank.h"
+#include "ParamSmoother.h"
+#include "NoteStack.h"
+#include "PartVoice.h"
+
+/*  The synth engine: every parameter, voice and modulation block of a
+    patch, and the two render steps.
+
+    control() is the engine part of updateControl() (envelopes, LFOs,
+    modulation matrix, glide) and next() the engine part of updateAudio()
+    (one output sample, unclipped). setParam() applies a GUI parameter by
+    id, setKeys() a new key mask like a key scan. The firmware wraps these
+    with its hardware (key scan, serial, DAC, telemetry, NVS), the host
+    tools in tools/ render the very same code with generated wave tables,
+    so offline renders and benchmarks are the firmware's engine.
+
+    Members are public like the globals they replace: the firmware and
+    tools/bench.cpp reach into the blocks directly. One instance owns all
+    of its state, so the host can render one instance per thread.
+*/
+
+#define numModValues 9
+#define numLfos 4 // LFO bank size, 2..9; LFO 1 + 2 are also the GUI's LFO1_* / LFO2_*
+#define numParts 2 // keyboard parts, 2..9; part 1 is the whole patch, parts 2.. are PartVoice layers
+#define keyNoteOffset 4 // key mask bit n plays note n - 4, bit 31 - key for key 0..31
+#define keyMask 0x1FFFFFFFUL // the first 3 keys (bits 31..29) don't exist on the keyboard
+#define SAMPLE_BLOCK_MAX 1024 // sample voice frames per control block, 48 kHz / MIN_CONTROL_RATE is 750
+
+enum filterTypes
+{
+  lowpass,
+  bandpass,
+  highpass,
+  notch
+};
+
+class SynthEngine
+{
+public:
+  //------------Variables changeable from GUI --------------------
+
+  // Global Settings
+  int OCTAVE = 4;
+  int SLIDETIME = 50;
+  int NOTE_PRIORITY = priorityLast;
+  bool NOTE_LEGATO = false; // true: a new note while one is held only glides, no envelope retrigger
+  int AUTOMATION_MODE = automationStop;
+
+  // Keyboard parts, PART_MODE from partModes. In split mode part p plays the keys
+  // PART_LOW<p>..PART_HIGH<p> (0 = lowest key .. 28), PART_OCT<p> shifts it by octaves
+  int PART_MODE = partSingle;
+  int partLow[numParts]; // whole keyboard from the constructor
+  int partHigh[numParts];
+  int partOctave[numParts];
+
+  // OSC 1
+  int OSC1_OCT = 0;
+  int OSC1_SEMI = 0;
+  int OSC1_LEVEL = 255;
+  int OSC1_FINE = 0;
+
+  // OSC 2
+  int OSC2_OCT = 0;
+  int OSC2_SEMI = 0;
+  int OSC2_LEVEL = 0;
+  int OSC2_FINE = 0;
+
+  // NOISE
+  int NOISE_LEVEL = 0;
+  int NOISE_TYPE = whiteNoise;
+  int NOISE_RATE = 64; // samples per step for sample & hold / crackle
+
+  // SAMPLE, played from the sample bank on every retriggered note
+  int SAMPLE_LEVEL = 0;
+  int SAMPLE_INDEX = 0;
+  int SAMPLE_TRACK = 1; // 1: pitch follows the keys, 0: always at the recorded pitch
+  int SAMPLE_START = 0; // start point in 1/256 of the sample length
+
+  // ENV 1
+  int ENV1_AL = 255;
+  int ENV1_DL = 255;
+  int ENV1_SL = 100;
+  int ENV1_RL = 0;
+  int ENV1_A = 20;
+  int ENV1_D = 500;
+  int ENV1_S = 5000;
+  int ENV1_R = 50;
+  int ENV1_MODE = envRetrigger;
+
+  // ENV 2
+  bool ENV2_STATE = false;
+  int ENV2_AL = 255;
+  int ENV2_DL = 255;
+  int ENV2_SL = 0;
+  int ENV2_RL = 0;
+  int ENV2_A = 5;
+  int ENV2_D = 40;
+  int ENV2_S = 200;
+  int ENV2_R = 50;
+  int ENV2_MODE = envRetrigger;
+
+  // Noise as modulation source
+  bool NOISEMOD_STATE = false;
+  int NOISEMOD_TYPE = sampleHoldNoise;
+  int NOISEMOD_RATE = 16; // control ticks per step
+
+  // Distortion
+  bool PREDISTSTATE = false;
+  int PREDISTAMOUNT = 0;
+  int PREDISTMODE = 0;
+
+  bool POSTDISTSTATE = false;
+  int POSTDISTAMOUNT = 0;
+  int POSTDISTMODE = 0;
+
+  // Filter
+  int FILTERSTATE = 0;
+  int FILTERTYPE = 0;
+  int FILTERCUTOFF = 255;
+  int FILTERRESONANCE = 5;
+
+  // Arpeggiator + step sequencer, the pattern itself lives in sequencer
+  int SEQ_MODE = seqOff;
+  int SEQ_TEMPO = 1200; // 0.1 BPM
+  int SEQ_DIVISION = 4; // steps per beat
+  int SEQ_SYNC = 0;     // always 0 (internal clock) until a clock input calls seqClockPulse()
+  int SEQ_STEP = 0;     // step edited by SEQ_NOTE, SEQ_GATE, SEQ_SLIDE and SEQ_LOCK_*
+  int ARP_MODE = arpUp;
+  int ARP_OCTAVES = 1;
+  int ARP_GATE = 4; // eighths of a step
+
+  //------------Modulation--------------------------------------
+
+  // Order of the modulation destinations: OSC 1 LEVEL, OSC 1 FINE, OSC 2 LEVEL, OSC 2 FINE,
+  // NOISELEVEL, PREDISTAMOUNT, POSTDISTAMOUNT, FILTERCUTOFF, FILTERRESONANCE
+  int modValues[numModValues];
+  int modulatedValuesOutput[numModValues];
+  int *ptrModValues[numModValues];
+
+  // Audio rate smoothing of the modulated values the render reads per sample: OSC 1 / 2 LEVEL,
+  // NOISELEVEL, FILTERCUTOFF and FILTERRESONANCE. Mode and time per value with
+  // <SMOOTH_MODE<n>:m> (smoothModes) and <SMOOTH_TIME<n>:ms>, n as in modValues.
+  // The levels advance a block at a time into the voice gains below, the filter every SMOOTH_STEP samples
+  ParamSmoother smoothers[numModValues];
+
+  int env2VarNdx[numModValues];
+  int env2Amount[numModValues];
+  int env2ModType[numModValues];
+
+  int lfoVarNdx[numLfos][numModValues];
+  int lfoAmount[numLfos][numModValues];
+  int lfoModType[numLfos][numModValues];
+
+  int noiseVarNdx[numModValues];
+  int noiseAmount[numModValues];
+  int noiseModType[numModValues];
+
+  // Routing arrays in the order of the indexed parameters
+  int *routingTables[lastRoutingParam - firstIndexedParam + 1];
+  int (*lfoRoutingTables[3])[numModValues];
+
+  uint8_t env2_now = 0;
+  int noiseMod_now = 0;
+
+  //------------Voices------------------------------------------
+
+  // OSC 1 + 2, playing from RAM copies of the selected tables
+  TableOsc osc1;
+  TableOsc osc2;
+  int8_t osc1Table[OSC_TABLE_CELLS];
+  int8_t osc2Table[OSC_TABLE_CELLS];
+
+  // NOISE, audio source + control rate modulation source
+  NoiseBlock noise; // rendered NOISE_BLOCK samples at a time
+  NoiseSource noiseMod;
+
+  // Voices of parts 2.., rendered in the same pass as part 1 with their own filter and
+  // cutoff modulation, added after part 1's distortion and filter
+  PartVoice partVoices[numParts - 1];
+  int8_t partTables[numParts - 1][2][OSC_TABLE_CELLS];
+  int8_t partTableLoads[numParts - 1][2]; // table waiting for its part to fade out, -1 for none
+
+  // SAMPLE, reading in place from the sample image handed to samples.begin()
+  SampleBank samples;
+  SampleVoice sampleVoice;
+  int16_t sampleBlock[SAMPLE_BLOCK_MAX]; // rendered by control(), played by next()
+  uint16_t sampleFrames = 0;
+  uint16_t samplePos = 0;
+
+  // ENV 1 + 2
+  BlockEnvelope env1;
+  BlockEnvelope env2;
+
+  // ENV 1 * OSC 1 / OSC 2 / NOISE level, set once per block, ramped per sample
+  GainRamp osc1Gain;
+  GainRamp osc2Gain;
+  GainRamp noiseGain;
+
+  // LFO bank, updated once per control tick
+  LfoBank<numLfos> lfos;
+
+  // Portamento for OSC 1 + 2
+  Glide slide1;
+  Glide slide2;
+
+  MultiFilter filter;
+
+  // Steps quality down when a patch gets too heavy, see qualityLevels for the order.
+  // Fed by the firmware's render time, host renders stay at qualityFull
+  QualityGovernor governor;
+  uint8_t qualityLevel = qualityFull; // level the stages were last set up for
+
+  //------------Keys, sequencer, automation----------------------
+
+  uint32_t currentKeys = 0; // key mask of the last setKeys()
+
+  // Held keys of each part by NOTE_PRIORITY, part 1 plays the note it picks while SEQ_MODE is off
+  NoteStack partKeys[numParts];
+
+  // Clocked from control() while SEQ_MODE is on, held keys feed the arpeggiator
+  // or transpose the pattern instead of playing directly
+  StepClock seqClock;
+  Arpeggiator arp;
+  StepSequencer sequencer;
+  uint8_t seqTranspose = 0;
+  bool seqNoteHeld = false;  // a sequenced note is sounding
+  int seqLockedParam = -1;   // modulation destination locked by the current step
+  int seqLockedBase = 0;     // its value before the lock
+
+  // Recorded GUI parameters and notes, <AUTOMATION:n> with n from automationModes.
+  // Times are rendered samples since the start, playback applies them in control()
+  AutomationStream automation;
+  uint32_t automationStart = 0;
+  uint32_t automationLength = 0; // samples from the start to the end of the recording
+
+  uint32_t renderedSamples = 0; // counted in next()
+
+  SynthEngine(uint32_t audio_rate, uint32_t control_rate)
+      : env1(control_rate), env2(control_rate), waveTables(0), numWaveTables(0)
+  {
+    int *mod[numModValues] = {&OSC1_LEVEL, &OSC1_FINE, &OSC2_LEVEL, &OSC2_FINE, &NOISE_LEVEL,
+                              &PREDISTAMOUNT, &POSTDISTAMOUNT, &FILTERCUTOFF, &FILTERRESONANCE};
+    int *routing[lastRoutingParam - firstIndexedParam + 1] = {
+        env2VarNdx, env2Amount, env2ModType, lfoVarNdx[0], lfoAmount[0], lfoModType[0],
+        lfoVarNdx[1], lfoAmount[1], lfoModType[1], noiseVarNdx, noiseAmount, noiseModType};
+    memcpy(ptrModValues, mod, sizeof(mod));
+    memcpy(routingTables, routing, sizeof(routing));
+    lfoRoutingTables[0] = lfoVarNdx;
+    lfoRoutingTables[1] = lfoAmount;
+    lfoRoutingTables[2] = lfoModType;
+    for (uint8_t i = 0; i < numModValues; i++)
+    {
+      modValues[i] = modulatedValuesOutput[i] = 0;
+      env2VarNdx[i] = noiseVarNdx[i] = -1;
+      env2Amount[i] = env2ModType[i] = noiseAmount[i] = noiseModType[i] = 0;
+    }
+
+    env1.setLevels(ENV1_AL, ENV1_DL, ENV1_SL, ENV1_RL);
+    env1.setTimes(ENV1_A, ENV1_D, ENV1_S, ENV1_R);
+    env2.setLevels(ENV2_AL, ENV2_DL, ENV2_SL, ENV2_RL);
+    env2.setTimes(ENV2_A, ENV2_D, ENV2_S, ENV2_R);
+    env1.setMode(ENV1_MODE);
+    env2.setMode(ENV2_MODE);
+    noise.source().setType(NOISE_TYPE);
+    noise.source().setRate(NOISE_RATE);
+    noiseMod.seed(0x2545F491UL);
+    noiseMod.setType(NOISEMOD_TYPE);
+    noiseMod.setRate(NOISEMOD_RATE);
+    lfos.setTempo(SEQ_TEMPO);
+    for (uint8_t l = 0; l < numLfos; l++)
+    {
+      lfos.setRate(l, 100); // 0.1 Hz
+      for (uint8_t i = 0; i < numModValues; i++)
+      {
+        lfoVarNdx[l][i] = -1;
+        lfoAmount[l][i] = 0;
+        lfoModType[l][i] = 0;
+      }
+    }
+    for (uint8_t p = 0; p < numParts; p++)
+    {
+      partLow[p] = 0;
+      partHigh[p] = 28;
+      partOctave[p] = 0;
+    }
+    setRates(makeRates(audio_rate, control_rate, control_rate));
+  }
+
+  // OSC*_TABLE / PART_OSC*_TABLE value n plays tables[n], copied to RAM; loads table 0 everywhere
+  void setWaveTables(const int8_t *const *tables, uint8_t count)
+  {
+    waveTables = tables;
+    numWaveTables = count;
+    loadOscTable(osc1, osc1Table, 0);
+    loadOscTable(osc2, osc2Table, 0);
+    for (uint8_t p = 0; p < numParts - 1; p++)
+    {
+      partTableLoads[p][0] = partTableLoads[p][1] = -1;
+      loadPartTable(p, 0, 0);
+      loadPartTable(p, 1, 0);
+    }
+  }
+
+  // Recomputes everything that depends on the rates
+  void setRates(const SynthRates &r)
+  {
+    rates = r;
+    osc1.setRate(rates.audioRate);
+    osc2.setRate(rates.audioRate);
+    env1.setRate(rates.controlRate);
+    env2.setRate(rates.controlRate);
+    osc1Gain.setBlockSize(rates.blockSize);
+    osc2Gain.setBlockSize(rates.blockSize);
+    noiseGain.setBlockSize(rates.blockSize);
+    slide1.setRate(rates.controlRate);
+    slide2.setRate(rates.controlRate);
+    slide1.setTime(SLIDETIME);
+    slide2.setTime(SLIDETIME);
+    lfos.setRates(rates.controlRate);
+    for (uint8_t p = 0; p < numParts - 1; p++)
+    {
+      partVoices[p].setRates(rates.controlRate, rates.audioRate);
+    }
+    for (uint8_t i = 0; i < numModValues; i++)
+    {
+      smoothers[i].setRates(rates.audioRate, rates.blockSize);
+    }
+  }
+
+  const SynthRates &getRates() const
+  {
+    return rates;
+  }
+
+  // Once per control tick, after the keys and before the block is rendered
+  void control()
+  {
+    if (AUTOMATION_MODE >= automationPlay)
+    {
+      playAutomation();
+    }
+    if (SEQ_MODE != seqOff)
+    {
+      runSequencer();
+    }
+    if (governor.getLevel() != qualityLevel)
+    {
+      applyQuality();
+    }
+    env1.update();
+    env2.update();
+    int lfo1 = lfos.getState(0) ? lfos.value(0) : 0;
+    for (uint8_t p = 0; p < numParts - 1; p++)
+    {
+      if (partVoices[p].silent())
+      {
+        for (uint8_t osc = 0; osc < 2; osc++)
+        {
+          if (partTableLoads[p][osc] >= 0)
+            copyPartTable(p, osc, partTableLoads[p][osc]);
+          partTableLoads[p][osc] = -1;
+        }
+        partVoices[p].fadeIn();
+      }
+      partVoices[p].update(lfo1);
+    }
+    env2_now = env2.value() >> 8;
+    lfos.update();
+    noiseMod_now = noiseMod.next();
+    modulator(ENV2_STATE, NOISEMOD_STATE);
+    setFreq();
+    smoothTo(0, modulatedValuesOutput[0]);
+    smoothTo(2, modulatedValuesOutput[2]);
+    smoothTo(4, modulatedValuesOutput[4]);
+    smoothTo(7, modulatedValuesOutput[7]);
+    smoothTo(8, modulatedValuesOutput[8]);
+    filter.setCutoffFreqAndResonance(smoothers[7].value(), smoothers[8].value()); // every SMOOTH_STEP in next() while moving
+    int32_t env1Level = env1.value();
+    osc1Gain.to((env1Level * smoothers[0].advanceBlock()) >> 8);
+    osc2Gain.to((env1Level * smoothers[2].advanceBlock()) >> 8);
+    noiseGain.to((env1Level * smoothers[4].advanceBlock()) >> 8);
+
+    // The sample voice reads flash, so it is rendered here and next() only reads RAM
+    sampleFrames = 0;
+    samplePos = 0;
+    if (SAMPLE_LEVEL != 0 && governor.allows(qualityNoSampleVoice) && sampleVoice.active())
+    {
+      sampleFrames = rates.blockSize < SAMPLE_BLOCK_MAX ? rates.blockSize : SAMPLE_BLOCK_MAX;
+      sampleVoice.render(sampleBlock, sampleFrames);
+    }
+  }
+
+  // Follows a governor step. Every stage that was skipped restarts clean instead of
+  // resuming from the state it was left in
+  void applyQuality()
+  {
+    uint8_t previous = qualityLevel;
+    qualityLevel = governor.getLevel();
+    if (previous >= qualityNoParts && governor.allows(qualityNoParts))
+    {
+      for (uint8_t p = 0; p < numParts - 1; p++)
+      {
+        if (partVoices[p].active())
+          partVoices[p].restart();
+      }
+    }
+    if (!governor.allows(qualityNoSampleVoice))
+    {
+      sampleVoice.stop();
+    }
+    noise.source().setType(governor.allows(qualityWhiteNoise) ? NOISE_TYPE : whiteNoise);
+    filter.setHalfRate(!governor.allows(qualityHalfRateFilter));
+  }
+
+  // One output sample, unclipped
+  AUDIO_HOT int next()
+  {
+    renderedSamples++;
+
+    if ((renderedSamples & (SMOOTH_STEP - 1)) == 0 && (smoothers[7].moving() || smoothers[8].moving()))
+    {
+      int cutoff = smoothers[7].next();
+      filter.setCutoffFreqAndResonance(cutoff, smoothers[8].next());
+    }
+
+    // 16 bit gains of envelope * level, scaled back by 8 bits after the multiply
+    int outputSignal = (((osc1.next() * osc1Gain.next() + osc2.next() * osc2Gain.next()) >> 8) * 3) >> 3;
+    if (samplePos < sampleFrames)
+    {
+      outputSignal += (sampleBlock[samplePos++] * SAMPLE_LEVEL) >> 9; // one-shots run past the envelope, about one oscillator at 255
+    }
+    outputSignal = distortion(outputSignal, PREDISTAMOUNT, PREDISTSTATE, PREDISTMODE);
+
+    if (!filter.getHalfRate() || (renderedSamples & 1))
+    {
+      filter.next(outputSignal);
+    }
+    if (FILTERSTATE)
+    {
+      switch (FILTERTYPE) // recover the output from the current selected filter type.
+      {
+      case lowpass:
+        outputSignal = filter.low(); // lowpassed sample
+        break;
+      case highpass:
+        outputSignal = filter.high(); // highpassed sample
+        break;
+      case bandpass:
+        outputSignal = filter.band(); // bandpassed sample
+        break;
+      case notch:
+        outputSignal = filter.notch(); // notched sample
+        break;
+      }
+    }
+    outputSignal = distortion(outputSignal, POSTDISTAMOUNT, POSTDISTSTATE, POSTDISTMODE);
+    if (governor.allows(qualityNoParts))
+    {
+      for (uint8_t p = 0; p < numParts - 1; p++)
+      {
+        if (partVoices[p].active())
+          outputSignal += partVoices[p].next();
+      }
+    }
+    if (NOISE_LEVEL != 0)
+    {
+      outputSignal += (noise.next() * noiseGain.next()) >> 10;
+    }
+    return outputSignal;
+  }
+
+  //---------------------Matrix------------------------------------------
+
+  void modulator(bool env2On, bool noiseModOn)
+  {
+    for (uint8_t i = 0; i < numModValues; i++)
+    {
+      modValues[i] = 0;
+    }
+    for (uint8_t i = 0; i < numModValues; i++)
+    {
+      if (env2On)
+      {
+        int output;
+
+        if (env2VarNdx[i] != -1)
+        {
+
+          if (env2ModType[i] == 0)
+          {
+            output = env2_now * env2Amount[i] >> 8;
+            modValues[env2VarNdx[i]] += output;
+          }
+          else
+          {
+            output = (env2_now - 128) * env2Amount[i] >> 8;
+            modValues[env2VarNdx[i]] += output;
+          }
+        }
+      }
+
+      for (uint8_t l = 0; l < numLfos; l++)
+      {
+        if (lfos.getState(l) && lfoVarNdx[l][i] != -1)
+        {
+          int now = lfos.value(l);
+          if (lfoModType[l][i] == 0)
+          {
+            modValues[lfoVarNdx[l][i]] += ((now + 128) * lfoAmount[l][i]) >> 8;
+          }
+          else
+          {
+            modValues[lfoVarNdx[l][i]] += (now * lfoAmount[l][i]) >> 8;
+          }
+        }
+      }
+
+      if (noiseModOn)
+      {
+        int output;
+
+        if (noiseVarNdx[i] != -1)
+        {
+          if (noiseModType[i] == 0)
+          {
+            output = ((noiseMod_now + 128) * noiseAmount[i]) >> 8;
+            modValues[noiseVarNdx[i]] += output;
+          }
+          else
+          {
+            output = (noiseMod_now * noiseAmount[i]) >> 8;
+            modValues[noiseVarNdx[i]] += output;
+          }
+        }
+      }
+    }
+
+    for (uint8_t i = 0; i < numModValues; i++)
+    {
+      int finalOutput = *ptrModValues[i] + modValues[i];
+      if (finalOutput > 255)
+        finalOutput = 255;
+      else if (finalOutput < -255)
+      {
+        finalOutput = -255;
+      }
+      modulatedValuesOutput[i] = finalOutput;
+    }
+  }
+
+  // Audio rate ramp to the new value, or one step per block once the governor gave up smoothing
+  void smoothTo(uint8_t i, int value)
+  {
+    if (governor.allows(qualityNoSmoothing))
+      smoothers[i].setTarget(value);
+    else
+      smoothers[i].jump(value);
+  }
+
+  //---------------------Tables------------------------------------------
+
+  // The oscillators only read their table in next(), which runs in the same task as
+  // setParam(), so the RAM copy can be rewritten in place
+  void loadOscTable(TableOsc &osc, int8_t *ramTable, int index)
+  {
+    if (index < 0 || index >= numWaveTables)
+      return;
+    memcpy(ramTable, waveTables[index], OSC_TABLE_CELLS);
+    osc.setTable(ramTable);
+  }
+
+  // Same for the RAM tables of part 2.. (part = part number - 2)
+  // A sounding part fades out for a block first, control() copies the table once it is silent
+  void loadPartTable(uint8_t part, uint8_t osc, int index)
+  {
+    if (index < 0 || index >= numWaveTables)
+      return;
+    if (partVoices[part].active())
+    {
+      partTableLoads[part][osc] = index;
+      partVoices[part].fadeOut();
+    }
+    else
+    {
+      copyPartTable(part, osc, index);
+    }
+  }
+
+  void copyPartTable(uint8_t part, uint8_t osc, int index)
+  {
+    memcpy(partTables[part][osc], waveTables[index], OSC_TABLE_CELLS);
+    partVoices[part].setTable(osc, partTables[part][osc]);
+  }
+
+  //---------------------Keyboard Stuff-----------------------------------
+
+  static float detune(float freq, int fine)
+  {
+    if (fine > 0)
+    {
+      return 0.0595 * freq * fine / 255; // Approximation for one semitone, exact formula not required here
+    }
+    if (fine < 0)
+    {
+      return 0.0561 * freq * fine / 255;
+    }
+    return 0;
+  }
+
+  void setFreq()
+  {
+    float slideFreq1 = slide1.next() / 65536.0f;
+    float slideFreq2 = slide2.next() / 65536.0f;
+    osc1.setFreq(slideFreq1 + detune(slideFreq1, modulatedValuesOutput[1]));
+    osc2.setFreq(slideFreq2 + detune(slideFreq2, modulatedValuesOutput[3]));
+  }
+
+  void handleNoteOn(uint8_t note)
+  {
+    glideTo(note);
+    env1.noteOn();
+    env2.noteOn();
+    lfos.noteOn();
+    if (SAMPLE_LEVEL != 0)
+    {
+      sampleVoice.start(samples, SAMPLE_INDEX, (OCTAVE + partOctave[0]) * 12 + note, SAMPLE_TRACK, SAMPLE_START,
+                        rates.audioRate);
+    }
+  }
+
+  void glideTo(uint8_t note)
+  {
+    uint8_t osc1note = (OCTAVE + partOctave[0] + OSC1_OCT) * 12 + note + OSC1_SEMI;
+    uint8_t osc2note = (OCTAVE + partOctave[0] + OSC2_OCT) * 12 + note + OSC2_SEMI;
+    slide1.start(osc1note);
+    slide2.start(osc2note);
+  }
+
+  void handleNoteOff()
+  {
+    env1.noteOff();
+    env2.noteOff();
+    sampleVoice.release();
+  }
+
+  // New key mask from a key scan, bit n plays note n - keyNoteOffset
+  void setKeys(uint32_t keys)
+  {
+    uint32_t changed = keys ^ currentKeys;
+    if (!changed)
+      return;
+    currentKeys = keys;
+    updatePartKeys();
+    uint32_t part1Keys = partMask(0); // the sequencer plays part 1
+    while (changed)
+    {
+      uint8_t bit = __builtin_ctz(changed);
+      uint8_t note = bit - keyNoteOffset;
+      bool pressed = currentKeys & (1UL << bit);
+      bool part1 = part1Keys & (1UL << bit);
+      changed &= changed - 1;
+      if (SEQ_MODE == seqArp && part1)
+      {
+        if (pressed)
+          arp.press(note);
+        else
+          arp.release(note);
+      }
+      else if (SEQ_MODE == seqPattern && part1 && pressed)
+      {
+        seqTranspose = partKeys[0].current() - keyNoteOffset;
+      }
+    }
+    playHeldKeys();
+  }
+
+  // Key mask bits a part plays, see PART_MODE
+  uint32_t partMask(uint8_t part)
+  {
+    if (PART_MODE == partLayer)
+      return keyMask;
+    if (PART_MODE == partSplit)
+      return ((2UL << partHigh[part]) - 1) & ~((1UL << partLow[part]) - 1);
+    return part == 0 ? keyMask : 0;
+  }
+
+  // Hands the held keys to the parts, after key changes and part routing changes
+  void updatePartKeys()
+  {
+    for (uint8_t p = 0; p < numParts; p++)
+    {
+      partKeys[p].update(currentKeys & partMask(p));
+    }
+  }
+
+  void playHeldKeys()
+  {
+    for (uint8_t p = SEQ_MODE == seqOff ? 0 : 1; p < numParts; p++)
+    {
+      playPart(p);
+    }
+  }
+
+  // Mono per part: follows the note NOTE_PRIORITY picks from the part's held keys, back to a still held one on release.
+  // Only part 1 notes are recorded by automation
+  void playPart(uint8_t part)
+  {
+    uint8_t action = partKeys[part].follow(NOTE_LEGATO);
+    uint8_t note = partKeys[part].sounding() - keyNoteOffset;
+    if (part > 0)
+    {
+      PartVoice &voice = partVoices[part - 1];
+      uint8_t midiNote = (OCTAVE + partOctave[part]) * 12 + note;
+      if (action == noteStart)
+        voice.noteOn(midiNote);
+      else if (action == noteGlide)
+        voice.setNote(midiNote);
+      else if (action == noteStop)
+        voice.noteOff();
+      return;
+    }
+    switch (action)
+    {
+    case noteStart:
+      if (AUTOMATION_MODE == automationRecord)
+        recordParam(paramNoteOn, 0, note);
+      handleNoteOn(note);
+      break;
+    case noteGlide:
+      if (AUTOMATION_MODE == automationRecord)
+        recordParam(paramNoteGlide, 0, note);
+      glideTo(note);
+      break;
+    case noteStop:
+      if (AUTOMATION_MODE == automationRecord)
+        recordParam(paramNoteOff, 0, 0);
+      handleNoteOff();
+      break;
+    default:
+      break;
+    }
+  }
+
+  //---------------------Sequencer----------------------------------------
+
+  // Switching modes releases the sequenced or keyboard note and restarts the clock on the next sample
+  void setSeqMode(int mode)
+  {
+    seqGateOff();
+    if (partKeys[0].sounding() != NOTE_NONE)
+    {
+      handleNoteOff();
+      partKeys[0].silence();
+    }
+    seqRestoreLock();
+    slide1.setTime(SLIDETIME);
+    slide2.setTime(SLIDETIME);
+    arp.clear(); // keys already held are not replayed
+    sequencer.reset();
+    seqClock.setTempo(rates.audioRate, SEQ_TEMPO, SEQ_DIVISION);
+    seqClock.restart();
+    lfos.restartSynced();
+    SEQ_MODE = mode;
+  }
+
+  // Steps and gate ends of the coming block, see StepClock for the timing
+  void runSequencer()
+  {
+    uint8_t events = seqClock.tick(rates.blockSize);
+    if (events & clockGateOff)
+    {
+      seqGateOff();
+    }
+    if (events & clockStep)
+    {
+      seqStep();
+    }
+  }
+
+  void seqStep()
+  {
+    seqRestoreLock();
+    if (SEQ_MODE == seqArp)
+    {
+      int16_t note = arp.next();
+      if (note < 0)
+      {
+        seqGateOff();
+        return;
+      }
+      seqNoteOn(note, false, ARP_GATE);
+      return;
+    }
+    const SeqStep &step = sequencer.advance();
+    uint8_t gate = step.gate & 0x0F;
+    if (gate == 0) // rest
+    {
+      seqGateOff();
+      seqClock.setGate(SEQ_GATE_FULL);
+      return;
+    }
+    if (step.lockParam < numModValues)
+    {
+      seqLockedParam = step.lockParam;
+      seqLockedBase = *ptrModValues[seqLockedParam];
+      *ptrModValues[seqLockedParam] = step.lockValue;
+    }
+    seqNoteOn(seqTranspose + step.note, step.gate & SEQ_SLIDE, gate);
+  }
+
+  // A sliding step glides from the still held note without retriggering the envelopes
+  void seqNoteOn(uint8_t note, bool slide, uint8_t gate)
+  {
+    unsigned int glide = slide ? SLIDETIME : 0;
+    slide1.setTime(glide);
+    slide2.setTime(glide);
+    if (slide && seqNoteHeld)
+    {
+      glideTo(note);
+    }
+    else
+    {
+      handleNoteOn(note);
+    }
+    seqNoteHeld = true;
+    seqClock.setGate(gate);
+  }
+
+  void seqGateOff()
+  {
+    if (seqNoteHeld)
+    {
+      handleNoteOff();
+      seqNoteHeld = false;
+    }
+  }
+
+  void seqRestoreLock()
+  {
+    if (seqLockedParam != -1)
+    {
+      *ptrModValues[seqLockedParam] = seqLockedBase;
+      seqLockedParam = -1;
+    }
+  }
+
+  // Call for each MIDI clock (0xF8) while SEQ_SYNC is 1. No input calls it yet, see paramSeqSync
+  void seqClockPulse()
+  {
+    if (SEQ_MODE != seqOff && seqClock.pulse(renderedSamples))
+    {
+      seqStep();
+    }
+  }
+
+  //---------------------Automation---------------------------------------
+
+  void recordParam(int id, int index, int val)
+  {
+    AutomationEvent e = {renderedSamples - automationStart, (uint8_t)id, (uint8_t)index, val};
+    if (!automation.append(e))
+      setAutomationMode(automationStop); // buffer full
+  }
+
+  // Recording starts a new stream, playing starts from its beginning
+  void setAutomationMode(int mode)
+  {
+    if (AUTOMATION_MODE == automationRecord && mode != automationRecord)
+      automationLength = renderedSamples - automationStart;
+    if (mode == automationRecord)
+      automation.clear();
+    automation.rewind();
+    automationStart = renderedSamples;
+    AUTOMATION_MODE = mode;
+  }
+
+  // Applies every event due within the block about to be rendered. Events are
+  // recorded at block starts, so playback lands on the recorded sample
+  void playAutomation()
+  {
+    AutomationEvent e;
+    while (automation.due(renderedSamples + rates.blockSize - 1 - automationStart) && automation.read(e))
+    {
+      setParam(e.id, e.index, e.value);
+    }
+    if (automation.finished())
+    {
+      if (AUTOMATION_MODE == automationLoop && automation.events() > 0)
+      {
+        if (renderedSamples + rates.blockSize - automationStart >= automationLength)
+        {
+          automation.rewind();
+          automationStart = renderedSamples + rates.blockSize;
+        }
+      }
+      else
+      {
+        AUTOMATION_MODE = automationStop;
+      }
+    }
+  }
+
+  //---------------------Parameters---------------------------------------
+
+  // GUI parameter by name (paramNames), false for unknown names
+  bool set(const char *name, int val)
+  {
+    int index = 0;
+    int id = paramId(name, index);
+    if (id == -1)
+      return false;
+    setParam(id, index, val);
+    return true;
+  }
+
+  // Applies an engine parameter by id, from the GUI or from automation playback in next().
+  // The ids the firmware handles itself (latency, telemetry, NVS) are ignored here
+  void setParam(int id, int index, int val)
+  {
+    switch (id)
+    {
+    case paramOsc1Table:
+      loadOscTable(osc1, osc1Table, val);
+      break;
+    case paramOsc2Table:
+      loadOscTable(osc2, osc2Table, val);
+      break;
+    case paramAutomation:
+      setAutomationMode(val);
+      break;
+
+    case paramSeqMode:
+      setSeqMode(val);
+      break;
+    case paramSeqTempo:
+      SEQ_TEMPO = clampValue(val, 200, 3000);
+      seqClock.setTempo(rates.audioRate, SEQ_TEMPO, SEQ_DIVISION);
+      lfos.setTempo(SEQ_TEMPO);
+      break;
+    case paramSeqDivision:
+      SEQ_DIVISION = clampValue(val, 1, SEQ_PPQN);
+      seqClock.setTempo(rates.audioRate, SEQ_TEMPO, SEQ_DIVISION);
+      break;
+    case paramSeqSync:
+      // Nothing feeds seqClockPulse() yet (no MIDI or GPIO clock input), and a synced clock
+      // would wait for pulses forever, so the sequencer stays on its internal clock
+      SEQ_SYNC = 0;
+      seqClock.setExternal(false);
+      break;
+    case paramSeqLength:
+      sequencer.setLength(val);
+      break;
+    case paramSeqStep:
+      SEQ_STEP = clampValue(val, 0, SEQ_MAX_STEPS - 1);
+      break;
+    case paramSeqNote:
+      sequencer.step(SEQ_STEP).note = val;
+      break;
+    case paramSeqGate:
+      sequencer.step(SEQ_STEP).gate = (sequencer.step(SEQ_STEP).gate & SEQ_SLIDE) | clampValue(val, 0, SEQ_GATE_FULL);
+      break;
+    case paramSeqSlide:
+      sequencer.step(SEQ_STEP).gate = (sequencer.step(SEQ_STEP).gate & 0x0F) | (val ? SEQ_SLIDE : 0);
+      break;
+    case paramSeqLockParam:
+      sequencer.step(SEQ_STEP).lockParam = val >= 0 && val < numModValues ? val : SEQ_NO_LOCK;
+      break;
+    case paramSeqLockValue:
+      sequencer.step(SEQ_STEP).lockValue = val;
+      break;
+    case paramSeqClear:
+      sequencer.clear();
+      break;
+    case paramArpMode:
+      ARP_MODE = val;
+      arp.setMode(val);
+      break;
+    case paramArpOctaves:
+      ARP_OCTAVES = val;
+      arp.setOctaves(val);
+      break;
+    case paramArpGate:
+      ARP_GATE = clampValue(val, 1, SEQ_GATE_FULL);
+      break;
+
+    case paramLfo1Table:
+      lfos.setShape(0, val);
+      break;
+    case paramLfo2Table:
+      lfos.setShape(1, val);
+      break;
+    case paramSlideTime:
+      SLIDETIME = val;
+      slide1.setTime(val);
+      slide2.setTime(val);
+      break;
+    case paramOctave:
+      OCTAVE = val;
+      break;
+    case paramNotePriority:
+      NOTE_PRIORITY = val;
+      for (uint8_t p = 0; p < numParts; p++)
+      {
+        partKeys[p].setPriority(val);
+      }
+      playHeldKeys();
+      break;
+    case paramNoteLegato:
+      NOTE_LEGATO = val;
+      break;
+    case paramPartMode:
+      PART_MODE = val;
+      updatePartKeys();
+      playHeldKeys();
+      break;
+
+    case paramOsc1Oct:
+      OSC1_OCT = val;
+      break;
+    case paramOsc1Semi:
+      OSC1_SEMI = val;
+      break;
+    case paramOsc1Level:
+      OSC1_LEVEL = val;
+      break;
+    case paramOsc1Fine:
+      OSC1_FINE = val;
+      break;
+    case paramOsc2Oct:
+      OSC2_OCT = val;
+      break;
+    case paramOsc2Semi:
+      OSC2_SEMI = val;
+      break;
+    case paramOsc2Level:
+      OSC2_LEVEL = val;
+      break;
+    case paramOsc2Fine:
+      OSC2_FINE = val;
+      break;
+
+    case paramNoiseLevel:
+      NOISE_LEVEL = val;
+      break;
+    case paramNoiseType:
+      NOISE_TYPE = val;
+      if (governor.allows(qualityWhiteNoise))
+        noise.source().setType(val);
+      break;
+    case paramNoiseRate:
+      NOISE_RATE = val;
+      noise.source().setRate(val);
+      break;
+    case paramSampleLevel:
+      SAMPLE_LEVEL = val;
+      if (val == 0)
+        sampleVoice.stop();
+      break;
+    case paramSampleIndex:
+      SAMPLE_INDEX = val;
+      break;
+    case paramSampleTrack:
+      SAMPLE_TRACK = val;
+      break;
+    case paramSampleStart:
+      SAMPLE_START = clampValue(val, 0, 255);
+      break;
+
+    //-------Envelopes----------------------
+    case paramEnv1AttackLevel:
+      env1.setAttackLevel(val);
+      break;
+    case paramEnv1DecayLevel:
+      env1.setDecayLevel(val);
+      break;
+    case paramEnv1SustainLevel:
+      env1.setSustainLevel(val);
+      break;
+    case paramEnv1ReleaseLevel:
+      env1.setReleaseLevel(val);
+      break;
+    case paramEnv1Attack:
+      env1.setAttackTime(val);
+      break;
+    case paramEnv1Decay:
+      env1.setDecayTime(val);
+      break;
+    case paramEnv1Sustain:
+      env1.setSustainTime(val);
+      break;
+    case paramEnv1Release:
+      env1.setReleaseTime(val);
+      break;
+    case paramEnv1Mode:
+      ENV1_MODE = val;
+      env1.setMode(val);
+      break;
+
+    case paramEnv2State:
+      ENV2_STATE = val;
+      break;
+    case paramEnv2AttackLevel:
+      env2.setAttackLevel(val);
+      break;
+    case paramEnv2DecayLevel:
+      env2.setDecayLevel(val);
+      break;
+    case paramEnv2SustainLevel:
+      env2.setSustainLevel(val);
+      break;
+    case paramEnv2ReleaseLevel:
+      env2.setReleaseLevel(val);
+      break;
+    case paramEnv2Attack:
+      env2.setAttackTime(val);
+      break;
+    case paramEnv2Decay:
+      env2.setDecayTime(val);
+      break;
+    case paramEnv2Sustain:
+      env2.setSustainTime(val);
+      break;
+    case paramEnv2Release:
+      env2.setReleaseTime(val);
+      break;
+    case paramEnv2Mode:
+      ENV2_MODE = val;
+      env2.setMode(val);
+      break;
+
+    case paramLfo1State:
+      lfos.setState(0, val);
+      break;
+    case paramLfo1Freq: // 0.1 Hz
+      lfos.setRate(0, val * 100);
+      break;
+    case paramLfo2State:
+      lfos.setState(1, val);
+      break;
+    case paramLfo2Freq:
+      lfos.setRate(1, val * 100);
+      break;
+
+    case paramNoiseModState:
+      NOISEMOD_STATE = val;
+      break;
+    case paramNoiseModType:
+      NOISEMOD_TYPE = val;
+      noiseMod.setType(val);
+      break;
+    case paramNoiseModRate:
+      NOISEMOD_RATE = val;
+      noiseMod.setRate(val);
+      break;
+
+    // Distortion
+    case paramPreDistAmount:
+      PREDISTAMOUNT = val;
+      break;
+    case paramPreDistMode:
+      PREDISTMODE = val;
+      break;
+    case paramPreDistState:
+      PREDISTSTATE = val;
+      break;
+    case paramPostDistAmount:
+      POSTDISTAMOUNT = val;
+      break;
+    case paramPostDistMode:
+      POSTDISTMODE = val;
+      break;
+    case paramPostDistState:
+      POSTDISTSTATE = val;
+      break;
+
+    //-------------Filter----------------------
+    case paramFilterState:
+      FILTERSTATE = val;
+      break;
+    case paramFilterType:
+      FILTERTYPE = val;
+      break;
+    case paramFilterCutoff:
+      FILTERCUTOFF = val;
+      break;
+    case paramFilterResonance:
+      FILTERRESONANCE = val;
+      break;
+
+    //--------------Modulator------------------
+    case paramEnvVarNdx:
+    case paramEnvAmount:
+    case paramEnvModType:
+    case paramLfo1VarNdx:
+    case paramLfo1Amount:
+    case paramLfo1ModType:
+    case paramLfo2VarNdx:
+    case paramLfo2Amount:
+    case paramLfo2ModType:
+    case paramNoiseVarNdx:
+    case paramNoiseAmount:
+    case paramNoiseModTypeNdx:
+      if (index >= 0 && index < numModValues)
+      {
+        routingTables[id - firstIndexedParam][index] = val;
+      }
+      break;
+
+    case paramLfoState:
+      lfos.setState(index - 1, val);
+      break;
+    case paramLfoShape:
+      lfos.setShape(index - 1, val);
+      break;
+    case paramLfoRate: // mHz
+      lfos.setRate(index - 1, val);
+      break;
+    case paramLfoSync: // lfoSyncs, 0: free running at LFO_RATE
+      lfos.setSync(index - 1, val);
+      break;
+    case paramLfoRetrigger:
+      lfos.setRetrigger(index - 1, val);
+      break;
+    case paramLfoPhase: // 1/256 cycle
+      lfos.setPhaseOffset(index - 1, clampValue(val, 0, 255));
+      break;
+    case paramLfoVarNdx:
+    case paramLfoAmount:
+    case paramLfoModType:
+      if (index / 10 >= 1 && index / 10 <= numLfos && index % 10 < numModValues)
+      {
+        lfoRoutingTables[id - paramLfoVarNdx][index / 10 - 1][index % 10] = val;
+      }
+      break;
+    case paramSmoothMode:
+      if (index < numModValues)
+        smoothers[index].setMode(val);
+      break;
+    case paramSmoothTime:
+      if (index < numModValues)
+        smoothers[index].setTime(clampValue(val, 0, 1000));
+      break;
+    case paramPartLow:
+    case paramPartHigh:
+    case paramPartOct:
+      if (index >= 1 && index <= numParts)
+      {
+        int *partValues[3] = {partLow, partHigh, partOctave};
+        partValues[id - paramPartLow][index - 1] = id == paramPartOct ? clampValue(val, -4, 4) : clampValue(val, 0, 28);
+        updatePartKeys();
+        playHeldKeys();
+      }
+      break;
+    case paramPartOsc1Table:
+    case paramPartOsc2Table:
+      if (index >= 2 && index <= numParts)
+        loadPartTable(index - 2, id - paramPartOsc1Table, val);
+      break;
+    case paramPartOsc1Level:
+    case paramPartOsc2Level:
+      if (index >= 2 && index <= numParts)
+        partVoices[index - 2].setLevel(id - paramPartOsc1Level, clampValue(val, 0, 255));
+      break;
+    case paramPartOsc2Semi:
+      if (index >= 2 && index <= numParts)
+        partVoices[index - 2].setOsc2Semi(clampValue(val, -24, 24));
+      break;
+    case paramPartOsc2Fine:
+      if (index >= 2 && index <= numParts)
+        partVoices[index - 2].setOsc2Fine(clampValue(val, -255, 255));
+      break;
+    case paramPartEnvAttack:
+    case paramPartEnvDecay:
+    case paramPartEnvSustainLevel:
+    case paramPartEnvSustain:
+    case paramPartEnvRelease:
+      if (index >= 2 && index <= numParts)
+      {
+        BlockEnvelope &env = partVoices[index - 2].envelope();
+        if (id == paramPartEnvAttack)
+          env.setAttackTime(val);
+        else if (id == paramPartEnvDecay)
+          env.setDecayTime(val);
+        else if (id == paramPartEnvSustainLevel)
+          env.setSustainLevel(val);
+        else if (id == paramPartEnvSustain)
+          env.setSustainTime(val);
+        else
+          env.setReleaseTime(val);
+      }
+      break;
+    case paramPartCutoff:
+      if (index >= 2 && index <= numParts)
+        partVoices[index - 2].setCutoff(clampValue(val, 0, 255));
+      break;
+    case paramPartResonance:
+      if (index >= 2 && index <= numParts)
+        partVoices[index - 2].setResonance(clampValue(val, 0, 255));
+      break;
+    case paramPartEnvCutoff:
+      if (index >= 2 && index <= numParts)
+        partVoices[index - 2].setEnvCutoff(clampValue(val, -255, 255));
+      break;
+    case paramPartLfoCutoff:
+      if (index >= 2 && index <= numParts)
+        partVoices[index - 2].setLfoCutoff(clampValue(val, -255, 255));
+      break;
+
+    case paramNoteOn:
+      handleNoteOn(val);
+      break;
+    case paramNoteGlide:
+      glideTo(val);
+      break;
+    case paramNoteOff:
+      handleNoteOff();
+      break;
+
+    default:
+      break;
+    }
+  }
+
+private:
+  SynthRates rates;
+  const int8_t *const *waveTables;
+  uint8_t numWaveTables;
+
+  SynthEngine(const SynthEngine &);            // ptrModValues and routingTables point into the instance
+  SynthEngine &operator=(const SynthEngine &);
+
+  static int clampValue(int val, int low, int high)
+  {
+    return val < low ? low : val > high ? high : val;
+  }
+};
+
+#endif /* SYNTHENGINE_H */
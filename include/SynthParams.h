@@ -0,0 +1,212 @@
+#ifndef SYNTHPARAMS_H
+#define SYNTHPARAMS_H
+
+#include <string.h>
+#include <ctype.h>
+
+/*  GUI parameter ids and names.
+
+    One namespace for everything the GUI sends as <NAME:value>: the engine
+    parameters SynthEngine::setParam() applies and the few the firmware
+    handles itself (latency, telemetry, spectrum, NVS). Shared by the
+    firmware's checkData() and the host tools, so patch files and
+    automation ids mean the same on both.
+*/
+
+// Parameter ids for checkData() and automation, in the order of paramNames.
+// Everything from firstAutomatedParam on is recorded while AUTOMATION is 1, except the
+// part tables: a table load in updateAudio() would copy 8 KB per part on playback.
+enum params
+{
+  paramOsc1Table,
+  paramOsc2Table,
+  paramLatencyTrace,
+  paramLatencyReport,
+  paramTelemetryMode,
+  paramScopeDecimation,
+  paramSpectrumRate,
+  paramSpectrumDecimation,
+  paramGovernorState,
+  paramAutomation,
+  paramControlRate,
+  paramSeqMode,
+  paramSeqTempo,
+  paramSeqDivision,
+  paramSeqSync,
+  paramSeqLength,
+  paramSeqStep,
+  paramSeqNote,
+  paramSeqGate,
+  paramSeqSlide,
+  paramSeqLockParam,
+  paramSeqLockValue,
+  paramSeqClear,
+  paramSeqSave,
+  paramSeqLoad,
+  paramArpMode,
+  paramArpOctaves,
+  paramArpGate,
+  paramLfo1Table, // first automated parameter
+  paramLfo2Table,
+  paramSlideTime,
+  paramOctave,
+  paramNotePriority,
+  paramNoteLegato,
+  paramPartMode,
+  paramOsc1Oct,
+  paramOsc1Semi,
+  paramOsc1Level,
+  paramOsc1Fine,
+  paramOsc2Oct,
+  paramOsc2Semi,
+  paramOsc2Level,
+  paramOsc2Fine,
+  paramNoiseLevel,
+  paramNoiseType,
+  paramNoiseRate,
+  paramSampleLevel,
+  paramSampleIndex,
+  paramSampleTrack,
+  paramSampleStart,
+  paramEnv1AttackLevel,
+  paramEnv1DecayLevel,
+  paramEnv1SustainLevel,
+  paramEnv1ReleaseLevel,
+  paramEnv1Attack,
+  paramEnv1Decay,
+  paramEnv1Sustain,
+  paramEnv1Release,
+  paramEnv1Mode,
+  paramEnv2State,
+  paramEnv2AttackLevel,
+  paramEnv2DecayLevel,
+  paramEnv2SustainLevel,
+  paramEnv2ReleaseLevel,
+  paramEnv2Attack,
+  paramEnv2Decay,
+  paramEnv2Sustain,
+  paramEnv2Release,
+  paramEnv2Mode,
+  paramLfo1State,
+  paramLfo1Freq,
+  paramLfo2State,
+  paramLfo2Freq,
+  paramNoiseModState,
+  paramNoiseModType,
+  paramNoiseModRate,
+  paramPreDistAmount,
+  paramPreDistMode,
+  paramPreDistState,
+  paramPostDistAmount,
+  paramPostDistMode,
+  paramPostDistState,
+  paramFilterState,
+  paramFilterType,
+  paramFilterCutoff,
+  paramFilterResonance,
+  paramEnvVarNdx, // routing parameters, the name is followed by the index digit
+  paramEnvAmount,
+  paramEnvModType,
+  paramLfo1VarNdx,
+  paramLfo1Amount,
+  paramLfo1ModType,
+  paramLfo2VarNdx,
+  paramLfo2Amount,
+  paramLfo2ModType,
+  paramNoiseVarNdx,
+  paramNoiseAmount,
+  paramNoiseModTypeNdx,
+  paramLfoState, // LFO bank, the name is followed by the LFO number (LFO_RATE3)
+  paramLfoShape,
+  paramLfoRate,
+  paramLfoSync,
+  paramLfoRetrigger,
+  paramLfoPhase,
+  paramLfoVarNdx, // LFO bank routing, followed by the LFO number and the slot (LFO_VARNDX31)
+  paramLfoAmount,
+  paramLfoModType,
+  paramSmoothMode, // per modulation destination, followed by its index (SMOOTH_TIME7)
+  paramSmoothTime,
+  paramPartLow, // followed by the part number (PART_OCT2), voice parameters from part 2 on
+  paramPartHigh,
+  paramPartOct,
+  paramPartOsc1Table,
+  paramPartOsc2Table,
+  paramPartOsc1Level,
+  paramPartOsc2Level,
+  paramPartOsc2Semi,
+  paramPartOsc2Fine,
+  paramPartEnvAttack,
+  paramPartEnvDecay,
+  paramPartEnvSustainLevel,
+  paramPartEnvSustain,
+  paramPartEnvRelease,
+  paramPartCutoff,
+  paramPartResonance,
+  paramPartEnvCutoff, // cutoff modulation by the part's envelope
+  paramPartLfoCutoff, // and by LFO 1
+  paramNoteOn, // value = note, recorded from the keyboard
+  paramNoteGlide, // legato change of the held note
+  paramNoteOff,
+  numParams
+};
+
+static_assert(numParams <= 256, "AutomationEvent stores parameter ids in one byte");
+
+#define firstAutomatedParam paramLfo1Table
+#define firstIndexedParam paramEnvVarNdx
+#define lastRoutingParam paramNoiseModTypeNdx
+#define lastIndexedParam paramPartLfoCutoff
+
+const char *const paramNames[numParams] = {
+    "OSC1_TABLE", "OSC2_TABLE", "LATENCY_TRACE", "LATENCY_REPORT", "TELEMETRY_MODE", "SCOPE_DECIMATION",
+    "SPECTRUM_RATE", "SPECTRUM_DECIMATION", "GOVERNOR_STATE", "AUTOMATION", "CONTROL_RATE",
+    "SEQ_MODE", "SEQ_TEMPO", "SEQ_DIVISION", "SEQ_SYNC", "SEQ_LENGTH", "SEQ_STEP", "SEQ_NOTE", "SEQ_GATE",
+    "SEQ_SLIDE", "SEQ_LOCK_PARAM", "SEQ_LOCK_VALUE", "SEQ_CLEAR", "SEQ_SAVE", "SEQ_LOAD",
+    "ARP_MODE", "ARP_OCTAVES", "ARP_GATE",
+    "LFO1_TABLE", "LFO2_TABLE", "SLIDETIME", "OCTAVE", "NOTE_PRIORITY", "NOTE_LEGATO", "PART_MODE",
+    "OSC1_OCT", "OSC1_SEMI", "OSC1_LEVEL", "OSC1_FINE", "OSC2_OCT", "OSC2_SEMI", "OSC2_LEVEL", "OSC2_FINE",
+    "NOISE_LEVEL", "NOISE_TYPE", "NOISE_RATE", "SAMPLE_LEVEL", "SAMPLE_INDEX", "SAMPLE_TRACK", "SAMPLE_START",
+    "ENV1_AL", "ENV1_DL", "ENV1_SL", "ENV1_RL", "ENV1_A", "ENV1_D", "ENV1_S", "ENV1_R", "ENV1_MODE",
+    "ENV2_STATE", "ENV2_AL", "ENV2_DL", "ENV2_SL", "ENV2_RL", "ENV2_A", "ENV2_D", "ENV2_S", "ENV2_R", "ENV2_MODE",
+    "LFO1_STATE", "LFO1_FREQ", "LFO2_STATE", "LFO2_FREQ",
+    "NOISEMOD_STATE", "NOISEMOD_TYPE", "NOISEMOD_RATE",
+    "PREDISTAMOUNT", "PREDISTMODE", "PREDISTSTATE", "POSTDISTAMOUNT", "POSTDISTMODE", "POSTDISTSTATE",
+    "FILTERSTATE", "FILTERTYPE", "FILTERCUTOFF", "FILTERRESONANCE",
+    "ENVVARNDX", "ENVAMOUNT_", "ENVMODTYPE", "LFO1VARNDX", "LFO1AMOUNT_", "LFO1MODTYPE",
+    "LFO2VARNDX", "LFO2AMOUNT_", "LFO2MODTYPE", "NOISEVARNDX", "NOISEAMOUNT_", "NOISEMODTYPE",
+    "LFO_STATE", "LFO_SHAPE", "LFO_RATE", "LFO_SYNC", "LFO_RETRIG", "LFO_PHASE",
+    "LFO_VARNDX", "LFO_AMOUNT_", "LFO_MODTYPE", "SMOOTH_MODE", "SMOOTH_TIME",
+    "PART_LOW", "PART_HIGH", "PART_OCT", "PART_OSC1_TABLE", "PART_OSC2_TABLE", "PART_OSC1_LEVEL", "PART_OSC2_LEVEL",
+    "PART_OSC2_SEMI", "PART_OSC2_FINE", "PART_ENV_A", "PART_ENV_D", "PART_ENV_SL", "PART_ENV_S", "PART_ENV_R",
+    "PART_CUTOFF", "PART_RESONANCE", "PART_ENV_CUTOFF", "PART_LFO_CUTOFF",
+    "NOTE_ON", "NOTE_GLIDE", "NOTE_OFF"};
+
+// Plain names match exactly, indexed names are the prefix plus one or two index digits
+// (ENVVARNDX3, LFO_VARNDX31)
+inline int paramId(const char *name, int &index)
+{
+  for (int id = 0; id < numParams; id++)
+  {
+    const char *prefix = paramNames[id];
+    if (id >= firstIndexedParam && id <= lastIndexedParam)
+    {
+      size_t len = strlen(prefix);
+      const char *digits = name + len;
+      if (strncmp(name, prefix, len) == 0 && isdigit(digits[0]) &&
+          (digits[1] == '\0' || (isdigit(digits[1]) && digits[2] == '\0')))
+      {
+        index = digits[1] ? (digits[0] - '0') * 10 + digits[1] - '0' : digits[0] - '0';
+        return id;
+      }
+    }
+    else if (strcmp(name, prefix) == 0)
+    {
+      index = 0;
+      return id;
+    }
+  }
+  return -1;
+}
+
+#endif /* SYNTHPARAMS_H */
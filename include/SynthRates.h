@@ -0,0 +1,40 @@
+#ifndef SYNTHRATES_H
+#define SYNTHRATES_H
+
+#include <stdint.h>
+
+/*  Rate descriptor of the running engine.
+
+    The audio rate is fixed per build (it drives Mozzi's output timer), the
+    control rate is chosen at boot and handed to startMozzi(). Every block
+    of SynthEngine takes the rates at run time through setRates(), none is
+    built for a compile time rate.
+*/
+
+#define MIN_CONTROL_RATE 64 // with ParamSmoother ramps the levels and the filter stay smooth down to here
+#define MAX_CONTROL_RATE 1024
+
+struct SynthRates
+{
+  uint32_t audioRate;
+  uint16_t controlRate;
+  uint16_t blockSize;    // audio samples per control tick
+};
+
+// Control rates are powers of two in MIN_CONTROL_RATE..MAX_CONTROL_RATE
+inline bool validControlRate(uint32_t rate)
+{
+  return rate >= MIN_CONTROL_RATE && rate <= MAX_CONTROL_RATE && (rate & (rate - 1)) == 0;
+}
+
+// An invalid control rate falls back to fallback_rate
+inline SynthRates makeRates(uint32_t audio_rate, uint32_t control_rate, uint16_t fallback_rate)
+{
+  SynthRates r;
+  r.audioRate = audio_rate;
+  r.controlRate = validControlRate(control_rate) ? control_rate : fallback_rate;
+  r.blockSize = audio_rate / r.controlRate;
+  return r;
+}
+
+#endif /* SYNTHRATES_H */
@@ -0,0 +1,51 @@
+#ifndef TABLEOSC_H
+#define TABLEOSC_H
+
+#include <stdint.h>
+#include "HotPath.h"
+
+/*  Wavetable oscillator of OSC 1 / OSC 2.
+
+    The arithmetic of Mozzi's Oscil<8192, AUDIO_RATE>: a 16.16 phase,
+    advanced before the table is read, the integer part masked to the
+    table size. The audio rate is a member instead of a template
+    parameter, so the host tools can render the same code at any rate.
+*/
+
+#define OSC_TABLE_BITS 13
+#define OSC_TABLE_CELLS (1 << OSC_TABLE_BITS) // like the 8192 cell Mozzi tables
+
+class TableOsc
+{
+public:
+  TableOsc() : table(0), audioRate(32768), phase(0), increment(0) {}
+
+  void setRate(uint32_t audio_rate)
+  {
+    audioRate = audio_rate ? audio_rate : 1;
+  }
+
+  void setTable(const int8_t *t)
+  {
+    table = t;
+  }
+
+  void setFreq(float hz)
+  {
+    increment = (uint32_t)((((float)OSC_TABLE_CELLS * hz) / audioRate) * 65536.0f);
+  }
+
+  inline AUDIO_HOT int8_t next()
+  {
+    phase += increment;
+    return table[(phase >> 16) & (OSC_TABLE_CELLS - 1)];
+  }
+
+private:
+  const int8_t *table;
+  uint32_t audioRate;
+  uint32_t phase; // 16.16 cells
+  uint32_t increment;
+};
+
+#endif /* TABLEOSC_H */
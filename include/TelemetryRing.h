@@ -0,0 +1,114 @@
+#ifndef TELEMETRYRING_H
+#define TELEMETRYRING_H
+
+#include <stdint.h>
+#include <atomic>
+#include "HotPath.h"
+
+/*  Lock-free telemetry / log ring.
+
+    Single producer (the Mozzi loop, i.e. updateControl() and updateAudio())
+    and single consumer (a low priority drain task). push() never blocks:
+    when the ring is full the record is dropped and counted. Records are
+    fixed size binary and carry their own timestamp.
+*/
+
+enum telemetryTypes
+{
+  telemetryParam,   // a = hash of the GUI name, b = value
+  telemetryNoteOn,  // id = note
+  telemetryNoteOff, // id = note
+  telemetryCpu,     // id = quality level, a = load in %, b = cycles of the last block
+  telemetryLevel,   // a = output peak since the last level record
+  telemetryScope,   // a = decimated output sample
+  telemetryQuality, // id = new quality level
+  telemetryDropped, // b = records dropped so far, added by the drain side
+  telemetryLatency  // id = field of the latency report, b = value
+};
+
+struct TelemetryRecord
+{
+  uint32_t time; // micros()
+  uint8_t type;
+  uint8_t id;
+  int16_t a;
+  int32_t b;
+};
+
+// SIZE must be a power of two, one slot stays empty to tell full from empty
+template <uint16_t SIZE>
+class TelemetryRing
+{
+public:
+  TelemetryRing() : head(0), tail(0), droppedCount(0)
+  {
+    static_assert((SIZE & (SIZE - 1)) == 0, "TelemetryRing size must be a power of two");
+  }
+
+  AUDIO_HOT bool push(uint32_t time, uint8_t type, uint8_t id, int16_t a, int32_t b)
+  {
+    uint16_t h = head.load(std::memory_order_relaxed);
+    uint16_t next = (h + 1) & (SIZE - 1);
+    if (next == tail.load(std::memory_order_acquire))
+    {
+      droppedCount.store(droppedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    TelemetryRecord &r = records[h];
+    r.time = time;
+    r.type = type;
+    r.id = id;
+    r.a = a;
+    r.b = b;
+    head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(TelemetryRecord &r)
+  {
+    uint16_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+      return false;
+    r = records[t];
+    tail.store((t + 1) & (SIZE - 1), std::memory_order_release);
+    return true;
+  }
+
+  uint16_t used() const
+  {
+    return (head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire)) & (SIZE - 1);
+  }
+
+  uint32_t dropped() const
+  {
+    return droppedCount.load(std::memory_order_relaxed);
+  }
+
+  // Empties the ring and the drop count, only while neither side is running
+  void reset()
+  {
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    droppedCount.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  TelemetryRecord records[SIZE];
+  std::atomic<uint16_t> head;
+  std::atomic<uint16_t> tail;
+  std::atomic<uint32_t> droppedCount; // written by the producer only
+};
+
+// 16 bit FNV-1a of a GUI parameter name, so parameter records stay fixed size
+inline uint16_t telemetryNameHash(const char *name)
+{
+  uint32_t h = 2166136261UL;
+  while (*name)
+  {
+    h ^= (uint8_t)*name++;
+    h *= 16777619UL;
+  }
+  return (uint16_t)(h ^ (h >> 16));
+}
+
+#endif /* TELEMETRYRING_H */
@@ -23,13 +23,15 @@
 // Code for the keyboard: https://www.youtube.com/watch?v=K-OPme8-BNA
 // Code for polyphony: https://github.com/jidagraphy/mozzi-poly-synth
 
-#define MOZZI_CONTROL_RATE 256 // Hz, powers of 2 are most reliable
-#define MOZZI_AUDIO_RATE 32768
+#ifndef SYNTH_AUDIO_RATE
+#define SYNTH_AUDIO_RATE 32768 // build with -D SYNTH_AUDIO_RATE=16384 (or 48000) to trade bandwidth for CPU
+#endif
+#define MOZZI_CONTROL_RATE 256 // Hz, default control rate until one is stored in NVS
+#define MOZZI_AUDIO_RATE SYNTH_AUDIO_RATE
 #define MOZZI_AUDIO_MODE MOZZI_OUTPUT_EXTERNAL_TIMED
 #define MOZZI_AUDIO_CHANNELS MOZZI_STEREO
 
 #include <Mozzi.h>
-#include <Oscil.h>
 #include <tables/saw8192_int8.h>
 #include <tables/sin8192_int8.h>
 #include <tables/triangle_warm8192_int8.h>
@@ -39,188 +41,115 @@
 #include <tables/sin2048_int8.h>
 #include <tables/triangle2048_int8.h>
 #include <tables/square_no_alias_2048_int8.h>
-#include <ADSR.h>
-#include <Portamento.h>
-#include <mozzi_fixmath.h>
-#include <ResonantFilter.h>
 #include <SPI.h>
+#include <esp_heap_caps.h>
+#include <esp_partition.h>
+#include <Preferences.h>
+#include "HotPath.h"
+#include "SynthEngine.h"
+#include "LatencyTrace.h"
+#include "TelemetryRing.h"
+#include "SpectrumAnalyzer.h"
+#ifdef SYNTH_BENCH
+#include <ADSR.h> // only to compare BlockEnvelope against the Mozzi envelope it replaced
+#endif
 
 #define matrix1 8 // input pins
 #define matrix2 4 // output pins
 #define numChars 32
-#define numModValues 9
+#define telemetrySize 256 // records, power of two
+#define levelTicks 16     // control ticks per output level record
+#define cpuTicks 256      // control ticks per CPU record
+#define spectrumSize 512  // FFT points, 256 to 1024
+#define automationBytes 65536 // automation stream in PSRAM, about 15 minutes of one knob moving continuously
+#define samplePartitionType 0x40 // data subtype of the "samples" partition, see partitions_samples.csv
 
 #define WS_pin1 1
 #define WS_pin2 2
 #define WS_pin3 4
 
-byte numVoices = 0;
+#define TRACE_PIN 21 // spare GPIO, high from key scan until the first affected sample leaves the DAC
 
 char receivedChars[numChars];
-bool currentState[matrix1 * matrix2];
-bool requestState[matrix1 * matrix2];
+uint32_t requestKeys = 0; // key mask of the last readKeys()
 
-byte env2_now = 0;
-int LFO1_now = 0;
-int LFO2_now = 0;
-int outputSignal = 0;
+uint32_t renderCycles = 0; // CPU cycles spent in updateControl + updateAudio since the last control tick
+uint32_t blockCycles = 0;  // CPU cycles per control tick, the render deadline
+
+volatile uint32_t outputSamples = 0; // counted in audioOutput, synth.renderedSamples in updateAudio
+
+volatile int16_t outputGain = 256; // applied in audioOutput, faded to 0 around flash writes
+volatile int16_t outputGainTarget = 256;
+
+int outputPeak = 0;  // largest output magnitude since the last level record
+int scopeCount = 0;
 
 //------------Functions-----------------------------------------
 void readKeys(void);
 void writeKeys(void);
 void checkData(void);
 void checkSerial(void);
-int distortion(int signal, int amount, bool enabled, int mode);
-float detune(float freq, int fine);
-void setFreq(void);
-void modulator(bool env2, bool lfo1, bool lfo2);
+void setParam(int id, int index, int val);
+void seqStore(int slot, bool save);
+void flashWriteBegin(void);
+void flashWriteEnd(void);
+void mapSamples(void);
+void loadRates(void);
+void storeControlRate(int rate);
+void traceNoteEvent(void);
+void printLatencyReport(void);
+void printLatencyRecord(const TelemetryRecord &r);
+void telemetryTask(void *parameter);
+void sendSpectrum(void);
+#ifdef SYNTH_BENCH
+void runBenchmarks(void);
+#endif
 
 //------------Variables changeable from GUI --------------------
 
-// Global Settings
-int OCTAVE = 4;
-int SLIDETIME = 50;
-
-// OSC 1
-int OSC1_OCT = 0;
-int OSC1_SEMI = 0;
-int OSC1_LEVEL = 255;
-int OSC1_FINE = 0;
-
-// OSC 2
-int OSC2_OCT = 0;
-int OSC2_SEMI = 0;
-int OSC2_LEVEL = 0;
-int OSC2_FINE = 0;
-
-// NOISE
-int NOISE_LEVEL = 0;
-
-// ENV 1
-int ENV1_AL = 255;
-int ENV1_DL = 255;
-int ENV1_SL = 100;
-int ENV1_RL = 0;
-int ENV1_A = 20;
-int ENV1_D = 500;
-int ENV1_S = 5000;
-int ENV1_R = 50;
-
-// ENV 2
-bool ENV2_STATE = false;
-int ENV2_AL = 255;
-int ENV2_DL = 255;
-int ENV2_SL = 0;
-int ENV2_RL = 0;
-int ENV2_A = 5;
-int ENV2_D = 40;
-int ENV2_S = 200;
-int ENV2_R = 50;
-
-// LFO 1 + 2
-bool LFO1_STATE = false;
-float LFO1_FREQ = 0.1f;
-
-bool LFO2_STATE = false;
-float LFO2_FREQ = 0.1f;
-
-// Distortion
-bool PREDISTSTATE = false;
-int PREDISTAMOUNT = 0;
-int PREDISTMODE = 0;
-
-bool POSTDISTSTATE = false;
-int POSTDISTAMOUNT = 0;
-int POSTDISTMODE = 0;
-
-// Filter
-int FILTERSTATE = 0;
-int FILTERTYPE = 0;
-int FILTERCUTOFF = 255;
-int FILTERRESONANCE = 5;
-
-int modValues[numModValues] = {
-    0, // OSC 1 LEVEL
-    0, // OSC 1 FINE
-    0, // OSC 2 LEVEL
-    0, // OSC 2 FINE
-    0, // NOISELEVEL
-    0, // PREDISTAMOUNT
-    0, // POSTDISTAMOUNT
-    0, // FILTERCUTOFF
-    0  // FILTERRESONANCE
-};
-
-int modulatedValuesOutput[numModValues] = {
-    0, // OSC 1 LEVEL
-    0, // OSC 1 FINE
-    0, // OSC 2 LEVEL
-    0, // OSC 2 FINE
-    0, // NOISELEVEL
-    0, // PREDISTAMOUNT
-    0, // POSTDISTAMOUNT
-    0, // FILTERCUTOFF
-    0  // FILTERRESONANCE
-
-};
-
-int *ptrModValues[numModValues] = {
-    &OSC1_LEVEL,
-    &OSC1_FINE,
-    &OSC2_LEVEL,
-    &OSC2_FINE,
-    &NOISE_LEVEL,
-    &PREDISTAMOUNT,
-    &POSTDISTAMOUNT,
-    &FILTERCUTOFF,
-    &FILTERRESONANCE //
-};
-
-int env2VarNdx[numModValues] = {-1, -1, -1, -1, -1, -1, -1, -1, -1};
-int env2Amount[numModValues] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
-int env2ModType[numModValues] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
-
-int LFO1VarNdx[numModValues] = {-1, -1, -1, -1, -1, -1, -1, -1, -1};
-int LFO1Amount[numModValues] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
-int LFO1ModType[numModValues] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
-
-int LFO2VarNdx[numModValues] = {-1, -1, -1, -1, -1, -1, -1, -1, -1};
-int LFO2Amount[numModValues] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
-int LFO2ModType[numModValues] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+// Firmware settings, the patch parameters live in synth (SynthEngine.h)
+int CONTROL_RATE = MOZZI_CONTROL_RATE; // stored in NVS by <CONTROL_RATE:n>, used from the next boot
+bool GOVERNOR_STATE = true;
+bool LATENCY_TRACE = false;
+int TELEMETRY_MODE = 0;   // 0: GUI values only, 1: also every record as binary frame on Serial
+int SCOPE_DECIMATION = 0; // 0: off, otherwise every n-th output sample is recorded
+int SPECTRUM_RATE = 0;       // <FFT:..> and <SCOPE:..> frames per second, 0: off
+int SPECTRUM_DECIMATION = 2; // output samples per analyzer tap
 
 //--------------------------------------------------------------
 
-// OSC 1 + 2
-Oscil<SIN8192_NUM_CELLS, MOZZI_AUDIO_RATE> osc1;
-Oscil<SIN8192_NUM_CELLS, MOZZI_AUDIO_RATE> osc2;
-Oscil<WHITENOISE8192_NUM_CELLS, MOZZI_AUDIO_RATE> noise;
-
-// ENV 1 + 2
-ADSR<MOZZI_CONTROL_RATE, MOZZI_AUDIO_RATE> env1;
-ADSR<MOZZI_CONTROL_RATE, MOZZI_CONTROL_RATE> env2;
+// The engine, rendered by updateControl() / updateAudio(). A plain global, so its RAM
+// wave tables are in internal RAM (.bss) like the AUDIO_DATA tables they replace
+SynthEngine synth(MOZZI_AUDIO_RATE, MOZZI_CONTROL_RATE);
 
-// LFO 1 + 2
-Oscil<SIN2048_NUM_CELLS, MOZZI_CONTROL_RATE> LFO1;
-Oscil<SIN2048_NUM_CELLS, MOZZI_CONTROL_RATE> LFO2;
+// OSC*_TABLE / PART_OSC*_TABLE values in order
+const int8_t *const oscTables[] = {SAW8192_DATA, SIN8192_DATA, SMOOTHSQUARE8192_DATA, TRIANGLE_WARM8192_DATA,
+                                   WHITENOISE8192_DATA};
 
-// Portamento for OSC 1 + 2
-Portamento<MOZZI_CONTROL_RATE> slide1;
-Portamento<MOZZI_CONTROL_RATE> slide2;
+// Written by the audio/control path without blocking, drained by telemetryTask on the other core
+TelemetryRing<telemetrySize> telemetry;
 
-MultiResonantFilter<uint8_t> filter; // Multifilter applied to a 8 bits signal.
-                                     // MultiResonantFilter<uint16_t> can also be used for signals with higher number of bits
-                                     // in this last case, both the cutoff frequency and the resonance are uint16_t,
-                                     // ranging from 0, to 65535.
+// Key-to-DAC latency of note events while LATENCY_TRACE is on, printed with <LATENCY_REPORT:1>
+LatencyTrace latency;
 
-enum types
+// id of the telemetryLatency records of one report, histogram buckets from latencyBucket0 on
+enum latencyFields
 {
-  lowpass,
-  bandpass,
-  highpass,
-  notch
+  latencyCount,
+  latencySkipped,
+  latencyMin,
+  latencyMean,
+  latencyMax,
+  latencyScanToRender,
+  latencyP50,
+  latencyP99,
+  latencyBucket0
 };
 
-void audioOutput(const AudioOutput f) // f is a structure containing both channels
+// Output taps for the GUI spectrum and scope, analysed by telemetryTask while SPECTRUM_RATE is set
+SpectrumAnalyzer<spectrumSize> spectrum;
+
+void AUDIO_HOT audioOutput(const AudioOutput f) // f is a structure containing both channels
 
 {
 
@@ -230,6 +159,14 @@ void audioOutput(const AudioOutput f) // f is a structure containing both channe
   uint16_t rightSignal = f.r();
   uint16_t leftSignal = f.l();
 
+  if (outputGain != outputGainTarget)
+    outputGain += outputGain < outputGainTarget ? 4 : -4; // 64 samples fade
+  if (outputGain != 256)
+  {
+    rightSignal = ((int16_t)rightSignal * outputGain) >> 8;
+    leftSignal = ((int16_t)leftSignal * outputGain) >> 8;
+  }
+
   digitalWrite(WS_pin1, LOW); // select Right channel
   digitalWrite(WS_pin2, LOW); // select Right channel
   digitalWrite(WS_pin3, LOW); // select Right channel
@@ -241,6 +178,12 @@ void audioOutput(const AudioOutput f) // f is a structure containing both channe
   digitalWrite(WS_pin3, HIGH); // select Right channel
 
   SPI.transfer16(leftSignal);
+
+  if (LATENCY_TRACE && latency.getState() == latencyRendered && latency.output(outputSamples, micros()))
+  {
+    digitalWrite(TRACE_PIN, LOW);
+  }
+  outputSamples++;
 }
 
 void setup()
@@ -248,6 +191,8 @@ void setup()
   pinMode(WS_pin1, OUTPUT);
   pinMode(WS_pin2, OUTPUT);
   pinMode(WS_pin3, OUTPUT);
+  pinMode(TRACE_PIN, OUTPUT);
+  digitalWrite(TRACE_PIN, LOW);
   // digitalWrite(WS_pin1, HIGH);
   // digitalWrite(WS_pin2, HIGH);
   // digitalWrite(WS_pin3, HIGH);
@@ -274,73 +219,89 @@ void setup()
   pinMode(14, INPUT_PULLUP); // 3
   pinMode(17, INPUT_PULLUP); // 4
 
-  slide1.setTime(SLIDETIME);
-  slide2.setTime(SLIDETIME);
-  env1.setLevels(ENV1_AL, ENV1_DL, ENV1_SL, ENV1_RL);
-  env1.setTimes(ENV1_A, ENV1_D, ENV1_S, ENV1_R);
-  env2.setLevels(ENV2_AL, ENV2_DL, ENV2_SL, ENV2_RL);
-  env2.setTimes(ENV2_A, ENV2_D, ENV2_S, ENV2_R);
-  osc1.setTable(SAW8192_DATA);
-  osc2.setTable(SAW8192_DATA);
-  noise.setTable(WHITENOISE8192_DATA);
-  noise.setFreq((float)MOZZI_AUDIO_RATE / WHITENOISE8192_SAMPLERATE);
-  LFO1.setTable(SIN2048_DATA);
-  LFO1.setFreq(LFO1_FREQ);
-  LFO2.setTable(SIN2048_DATA);
-  LFO2.setFreq(LFO2_FREQ);
-
-  startMozzi(MOZZI_CONTROL_RATE);
+  synth.setWaveTables(oscTables, sizeof(oscTables) / sizeof(oscTables[0]));
+  synth.lfos.setTable(lfoSine, SIN2048_DATA);
+  synth.lfos.setTable(lfoSaw, SAW2048_DATA);
+  synth.lfos.setTable(lfoSquare, SQUARE_NO_ALIAS_2048_DATA);
+  synth.lfos.setTable(lfoTriangle, TRIANGLE2048_DATA);
+  loadRates();
+  mapSamples();
+
+  uint32_t automationSize = automationBytes;
+  uint8_t *automationBuffer = (uint8_t *)heap_caps_malloc(automationSize, MALLOC_CAP_SPIRAM);
+  if (automationBuffer == NULL) // no PSRAM: a smaller stream in internal RAM
+  {
+    automationSize = automationBytes / 8;
+    automationBuffer = (uint8_t *)malloc(automationSize);
+  }
+  synth.automation.begin(automationBuffer, automationBuffer ? automationSize : 0);
+
+#ifdef SYNTH_BENCH
+  runBenchmarks();
+#endif
+  xTaskCreatePinnedToCore(telemetryTask, "telemetry", 4096, NULL, 1, NULL, 0);
+
+  startMozzi(synth.getRates().controlRate);
   Serial.println("Setup done");
 }
 
 void updateControl()
 {
+  static uint16_t telemetryTicks = 0;
+  static int automationMode = automationStop;
+  uint32_t controlStart = ESP.getCycleCount();
+  if (GOVERNOR_STATE && synth.governor.update(renderCycles, blockCycles))
+  {
+    telemetry.push(micros(), telemetryQuality, synth.governor.getLevel(), 0, 0);
+  }
+  telemetryTicks++;
+  if (telemetryTicks % levelTicks == 0)
+  {
+    telemetry.push(micros(), telemetryLevel, 0, outputPeak > 32767 ? 32767 : outputPeak, 0);
+    outputPeak = 0;
+  }
+  if (telemetryTicks % cpuTicks == 0)
+  {
+    telemetry.push(micros(), telemetryCpu, synth.governor.getLevel(), synth.governor.getLoad(), renderCycles);
+  }
+  renderCycles = 0;
+
   checkSerial();
   readKeys();
   writeKeys();
 
-  env1.update();
-  env2.update();
-  env2_now = env2.next();
-  LFO1_now = LFO1.next();
-  LFO2_now = LFO2.next();
-  modulator(ENV2_STATE, LFO1_STATE, LFO2_STATE);
-  setFreq();
-  filter.setCutoffFreqAndResonance(modulatedValuesOutput[7], modulatedValuesOutput[8]);
+  // recording, a full buffer and the end of playback all change the mode
+  if (synth.AUTOMATION_MODE != automationMode)
+  {
+    automationMode = synth.AUTOMATION_MODE;
+    telemetry.push(micros(), telemetryParam, 0, (int16_t)telemetryNameHash("AUTOMATION_SIZE"), synth.automation.size());
+  }
+
+  synth.control();
+  renderCycles += ESP.getCycleCount() - controlStart;
 }
 
-AudioOutput updateAudio()
+AudioOutput AUDIO_HOT updateAudio()
 {
+  uint32_t audioStart = ESP.getCycleCount();
   int asig;
-  int env1next = env1.next();
-  outputSignal = (env1next * ((osc1.next() * modulatedValuesOutput[0] + osc2.next() * modulatedValuesOutput[2]) >> 8) * 3) >> 3;
-  outputSignal = distortion(outputSignal, PREDISTAMOUNT, PREDISTSTATE, PREDISTMODE);
-
-  filter.next(outputSignal);
-  if (FILTERSTATE)
+  if (LATENCY_TRACE && latency.getState() == latencyScanned)
   {
-    switch (FILTERTYPE) // recover the output from the current selected filter type.
-    {
-    case lowpass:
-      outputSignal = filter.low(); // lowpassed sample
-      break;
-    case highpass:
-      outputSignal = filter.high(); // highpassed sample
-      break;
-    case bandpass:
-      outputSignal = filter.band(); // bandpassed sample
-      break;
-    case notch:
-      outputSignal = filter.notch(); // notched sample
-      break;
-    }
+    latency.rendered(synth.renderedSamples, micros());
   }
-  outputSignal = distortion(outputSignal, POSTDISTAMOUNT, POSTDISTSTATE, POSTDISTMODE);
-  if (NOISE_LEVEL != 0)
+  asig = synth.next();
+  if (abs(asig) > outputPeak)
+    outputPeak = abs(asig);
+  if (SCOPE_DECIMATION && ++scopeCount >= SCOPE_DECIMATION)
   {
-    outputSignal += (env1next * noise.next() * modulatedValuesOutput[4] >> 8) >> 2;
+    scopeCount = 0;
+    telemetry.push(micros(), telemetryScope, 0, constrain(asig, -32768, 32767), 0);
   }
-  asig = outputSignal;
+  if (SPECTRUM_RATE)
+  {
+    spectrum.tap(constrain(asig, -32768, 32767));
+  }
+  renderCycles += ESP.getCycleCount() - audioStart;
   return StereoOutput::from16Bit(asig, asig);
 }
 
@@ -355,173 +316,78 @@ void loop()
 \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\
 */
 
-//---------------------Effects------------------------------------------
+//---------------------Memory Placement---------------------------------
 
-int distortion(int signal, int amount, bool enabled, int mode)
+// While the flash cache is off the output ISR can be held back, fade to silence first
+// so the DAC holds 0 instead of a frozen sample
+void flashWriteBegin()
 {
-  if (enabled)
+  outputGainTarget = 0;
+  while (outputGain != 0)
   {
-    amount = 1 + amount / 51;
-    if (mode == 0)
-    {
-      int output = signal * amount;
-      if (output > 24500) // almost 3/4 of 2^15 (amplitude goes to max 16bit/2), left a little bit of headroom
-      {
-        return 24500;
-      }
-      if (output < -24500)
-      {
-        return -24500;
-      }
-      else
-      {
-        return output;
-      }
-    }
-    if (mode == 1)
-    {
-      int output = signal * amount;
-      if (output > 32768)
-      {
-        return 32768 - (output - 32768);
-      }
-      if (output < -32768)
-      {
-        return -32768 - (output + 32768);
-      }
-      else
-      {
-        return output;
-      }
-    }
+    delay(1);
   }
-  return signal;
 }
 
-//---------------------Matrix------------------------------------------
-
-void modulator(bool env2, bool lfo1, bool lfo2)
+void flashWriteEnd()
 {
-  for (byte i = 0; i < numModValues; i++)
-  {
-    modValues[i] = 0;
-  }
-  for (byte i = 0; i < numModValues; i++)
-  {
-    if (env2)
-    {
-      int output;
-
-      if (env2VarNdx[i] != -1)
-      {
-
-        if (env2ModType[i] == 0)
-        {
-          output = env2_now * env2Amount[i] >> 8;
-          modValues[env2VarNdx[i]] += output;
-        }
-        else
-        {
-          output = (env2_now - 128) * env2Amount[i] >> 8;
-          modValues[env2VarNdx[i]] += output;
-        }
-      }
-    }
-
-    if (lfo1)
-    {
-      int output;
-
-      if (LFO1VarNdx[i] != -1)
-      {
-
-        if (LFO1ModType[i] == 0)
-        {
-          output = ((LFO1_now + 128) * LFO1Amount[i]) >> 8;
-          modValues[LFO1VarNdx[i]] += output;
-        }
-        else
-        {
-          output = (LFO1_now * LFO1Amount[i]) >> 8;
-          modValues[LFO1VarNdx[i]] += output;
-        }
-      }
-    }
-
-    if (lfo2)
-    {
-      int output;
-
-      if (LFO2VarNdx[i] != -1)
-      {
-        if (LFO2ModType[i] == 0)
-        {
-          output = ((LFO2_now + 128) * LFO2Amount[i]) >> 8;
-          modValues[LFO2VarNdx[i]] += output;
-        }
-        else
-        {
-          output = (LFO2_now * LFO2Amount[i]) >> 8;
-          modValues[LFO2VarNdx[i]] += output;
-        }
-      }
-    }
-  }
-
-  for (byte i = 0; i < numModValues; i++)
-  {
-    int finalOutput = *ptrModValues[i] + modValues[i];
-    if (finalOutput > 255)
-      finalOutput = 255;
-    else if (finalOutput < -255)
-    {
-      finalOutput = -255;
-    }
-    modulatedValuesOutput[i] = finalOutput;
-  }
+  outputGainTarget = 256;
 }
 
-//---------------------Keyboard Stuff-----------------------------------
-float detune(float freq, int fine)
+// Maps the "samples" partition (tools/pack_samples.py) into the data address space.
+// The mapping stays for the whole run; synth.control() reads it through the flash cache,
+// which is safe because flash writes only happen from the same task, between blocks.
+void mapSamples()
 {
-  fine = fine;
-  if (fine > 0)
+  const esp_partition_t *partition =
+      esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)samplePartitionType, "samples");
+  const void *image = NULL;
+  spi_flash_mmap_handle_t handle;
+  if (partition == NULL ||
+      esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &image, &handle) != ESP_OK)
   {
-    return 0.0595 * freq * fine / 255; // Approximation for one semitone, exact formula not required here
+    Serial.println("No sample partition");
+    return;
   }
-  if (fine < 0)
+  if (!synth.samples.begin((const uint8_t *)image, partition->size))
   {
-    return 0.0561 * freq * fine / 255;
+    Serial.println("No valid sample image");
+    return;
   }
-  return 0;
+  Serial.printf("%u samples\n", synth.samples.size());
 }
 
-void setFreq()
-{
-  float slideFreq1 = Q16n16_to_float(slide1.next());
-  float slideFreq2 = Q16n16_to_float(slide2.next());
-  osc1.setFreq(slideFreq1 + detune(slideFreq1, modulatedValuesOutput[1]));
-  osc2.setFreq(slideFreq2 + detune(slideFreq2, modulatedValuesOutput[3]));
-}
+//---------------------Rates--------------------------------------------
 
-void handleNoteOn(byte note)
+// Control rate from NVS, the audio rate is fixed per build (SYNTH_AUDIO_RATE)
+void loadRates()
 {
-  byte osc1note = (OCTAVE + OSC1_OCT) * 12 + note + OSC1_SEMI;
-  byte osc2note = (OCTAVE + OSC2_OCT) * 12 + note + OSC2_SEMI;
-  slide1.start(osc1note);
-  slide2.start(osc2note);
-  env1.noteOn();
-  env2.noteOn();
+  Preferences prefs;
+  prefs.begin("synth", true);
+  synth.setRates(makeRates(MOZZI_AUDIO_RATE, prefs.getUShort("controlRate", MOZZI_CONTROL_RATE), MOZZI_CONTROL_RATE));
+  prefs.end();
+  CONTROL_RATE = synth.getRates().controlRate;
+  blockCycles = ESP.getCpuFreqMHz() * 1000000UL / CONTROL_RATE;
 }
 
-void handleNoteOff()
+// Mozzi's control rate is set once by startMozzi(), so a new rate is stored for the next boot
+void storeControlRate(int rate)
 {
-  env1.noteOff();
-  env2.noteOff();
+  if (!validControlRate(rate))
+    return;
+  flashWriteBegin();
+  Preferences prefs;
+  prefs.begin("synth", false);
+  prefs.putUShort("controlRate", rate);
+  prefs.end();
+  flashWriteEnd();
+  CONTROL_RATE = rate;
 }
 
+//---------------------Keyboard Stuff-----------------------------------
 void readKeys()
 {
+  uint32_t keys = 0;
   // check all matrix1 pins for each matrix2 output
   for (int i = 0; i < matrix2; i++)
   {
@@ -553,40 +419,338 @@ void readKeys()
       digitalWrite(17, LOW);
     }
 
-    // Read all the column inputs for the current row
-    requestState[i * matrix1 + 0] = !digitalRead(6);
-    requestState[i * matrix1 + 1] = !digitalRead(7);
-    requestState[i * matrix1 + 2] = !digitalRead(8);
-    requestState[i * matrix1 + 3] = !digitalRead(39);
-    requestState[i * matrix1 + 4] = !digitalRead(40);
-    requestState[i * matrix1 + 5] = !digitalRead(41);
-    requestState[i * matrix1 + 6] = !digitalRead(42);
-    requestState[i * matrix1 + 7] = !digitalRead(5);
-  }
+    // Read all the column inputs for the current row, key i * matrix1 + column is bit 31 - key
+    int bit = 31 - i * matrix1;
+    keys |= (uint32_t)!digitalRead(6) << bit;
+    keys |= (uint32_t)!digitalRead(7) << (bit - 1);
+    keys |= (uint32_t)!digitalRead(8) << (bit - 2);
+    keys |= (uint32_t)!digitalRead(39) << (bit - 3);
+    keys |= (uint32_t)!digitalRead(40) << (bit - 4);
+    keys |= (uint32_t)!digitalRead(41) << (bit - 5);
+    keys |= (uint32_t)!digitalRead(42) << (bit - 6);
+    keys |= (uint32_t)!digitalRead(5) << (bit - 7);
+  }
+  requestKeys = keys & keyMask;
 }
 
+// Traces and reports every changed key, the engine plays them
 void writeKeys()
 {
-  for (int i = 3; i < matrix1 * matrix2; i++) // The first 3 Keys don't exist on the keyboard
+  uint32_t changed = requestKeys ^ synth.currentKeys;
+  if (!changed)
+    return;
+  while (changed)
+  {
+    byte bit = __builtin_ctz(changed);
+    changed &= changed - 1;
+    traceNoteEvent();
+    telemetry.push(micros(), requestKeys & (1UL << bit) ? telemetryNoteOn : telemetryNoteOff, bit - keyNoteOffset, 0, 0);
+  }
+  synth.setKeys(requestKeys);
+}
+
+//---------------------Latency Tracing----------------------------------
+
+void traceNoteEvent()
+{
+  if (LATENCY_TRACE && latency.scanned(micros()))
   {
-    if (requestState[i] == true && currentState[i] == false)
+    digitalWrite(TRACE_PIN, HIGH);
+  }
+}
+
+// Runs in the control path, so the report goes through the telemetry ring as
+// telemetryLatency records and telemetryTask prints it
+void printLatencyReport()
+{
+  const LatencyStats &stats = latency.getStats();
+  uint32_t now = micros();
+  telemetry.push(now, telemetryLatency, latencyCount, 0, stats.count);
+  telemetry.push(now, telemetryLatency, latencySkipped, 0, stats.skipped);
+  if (stats.count == 0)
+    return;
+  telemetry.push(now, telemetryLatency, latencyMin, 0, stats.minUs);
+  telemetry.push(now, telemetryLatency, latencyMean, 0, stats.sumUs / stats.count);
+  telemetry.push(now, telemetryLatency, latencyMax, 0, stats.maxUs);
+  telemetry.push(now, telemetryLatency, latencyScanToRender, 0, stats.sumScanToRenderUs / stats.count);
+  telemetry.push(now, telemetryLatency, latencyP50, 0, latency.percentileUs(500));
+  telemetry.push(now, telemetryLatency, latencyP99, 0, latency.percentileUs(990));
+  for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+  {
+    if (stats.histogram[i])
+      telemetry.push(now, telemetryLatency, latencyBucket0 + i, 0, stats.histogram[i]);
+  }
+}
+
+// Text of one telemetryLatency record, a line is printed once its last field arrived
+void printLatencyRecord(const TelemetryRecord &r)
+{
+  static uint32_t fields[latencyBucket0];
+  if (r.id >= latencyBucket0)
+  {
+    Serial.printf("%5u us: %lu\n", (r.id - latencyBucket0) * LATENCY_BUCKET_US, (unsigned long)r.b);
+    return;
+  }
+  fields[r.id] = r.b;
+  switch (r.id)
+  {
+  case latencySkipped:
+    Serial.printf("Latency: %lu events, %lu skipped\n", (unsigned long)fields[latencyCount], (unsigned long)fields[latencySkipped]);
+    break;
+  case latencyScanToRender:
+    Serial.printf("min %lu us, mean %lu us, max %lu us, mean scan->render %lu us\n", (unsigned long)fields[latencyMin],
+                  (unsigned long)fields[latencyMean], (unsigned long)fields[latencyMax], (unsigned long)fields[latencyScanToRender]);
+    break;
+  case latencyP99:
+    Serial.printf("p50 <%lu us, p99 <%lu us\n", (unsigned long)fields[latencyP50], (unsigned long)fields[latencyP99]);
+    break;
+  default:
+    break;
+  }
+}
+
+//---------------------Telemetry----------------------------------------
+
+// Low priority drain of the telemetry ring: GUI values go to Serial1 as <NAME:value>,
+// with TELEMETRY_MODE 1 every record is also sent to Serial as 0xA5 + raw TelemetryRecord
+void telemetryTask(void *parameter)
+{
+  TelemetryRecord r;
+  uint32_t reportedDrops = 0;
+  for (;;)
+  {
+    while (telemetry.pop(r))
     {
-      static byte note;
-      currentState[i] = requestState[i];
-      note = 27 - i;
-      handleNoteOn(note);
-      numVoices++;
+      if (TELEMETRY_MODE == 1)
+      {
+        Serial.write(0xA5);
+        Serial.write((const uint8_t *)&r, sizeof(r));
+      }
+      switch (r.type)
+      {
+      case telemetryLevel:
+        Serial1.printf("<LEVEL:%d>", r.a);
+        break;
+      case telemetryCpu:
+        Serial1.printf("<CPU:%d>", r.a);
+        break;
+      case telemetryQuality:
+        Serial1.printf("<QUALITY:%u>", r.id);
+        break;
+      case telemetryLatency:
+        if (TELEMETRY_MODE != 1) // the binary stream already carries the record
+          printLatencyRecord(r);
+        break;
+      default:
+        break;
+      }
+    }
+    uint32_t drops = telemetry.dropped();
+    if (drops != reportedDrops)
+    {
+      reportedDrops = drops;
+      if (TELEMETRY_MODE == 1)
+      {
+        TelemetryRecord d = {(uint32_t)micros(), telemetryDropped, 0, 0, (int32_t)drops};
+        Serial.write(0xA5);
+        Serial.write((const uint8_t *)&d, sizeof(d));
+      }
     }
+    sendSpectrum();
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+// One <FFT:..> frame (SPECTRUM_BANDS bytes in 0.5 dB steps) and one <SCOPE:..> frame
+// (SPECTRUM_SCOPE_POINTS signed bytes) as hex, at most SPECTRUM_RATE times per second.
+// Both together are about 210 bytes, so 9600 baud carries about 4 frames per second.
+void sendSpectrum()
+{
+  static uint32_t lastFrame = 0;
+  static const char hexDigits[] = "0123456789ABCDEF";
+  uint8_t bands[SPECTRUM_BANDS];
+  int8_t scope[SPECTRUM_SCOPE_POINTS];
+  char line[2 * SPECTRUM_SCOPE_POINTS + 10];
+
+  if (SPECTRUM_RATE <= 0 || millis() - lastFrame < 1000UL / SPECTRUM_RATE || !spectrum.process(bands, scope))
+    return;
+  lastFrame = millis();
+
+  int n = sprintf(line, "<FFT:");
+  for (int i = 0; i < SPECTRUM_BANDS; i++)
+  {
+    line[n++] = hexDigits[bands[i] >> 4];
+    line[n++] = hexDigits[bands[i] & 0x0F];
+  }
+  line[n++] = '>';
+  Serial1.write((const uint8_t *)line, n);
+
+  n = sprintf(line, "<SCOPE:");
+  for (int i = 0; i < SPECTRUM_SCOPE_POINTS; i++)
+  {
+    uint8_t v = (uint8_t)scope[i];
+    line[n++] = hexDigits[v >> 4];
+    line[n++] = hexDigits[v & 0x0F];
+  }
+  line[n++] = '>';
+  Serial1.write((const uint8_t *)line, n);
+}
+
+//---------------------Sequencer----------------------------------------
 
-    if (requestState[i] == false && currentState[i] == true)
+// Patterns are kept in NVS as fixed size SeqPattern blobs, slots 0-7
+void seqStore(int slot, bool save)
+{
+  if (slot < 0 || slot > 7)
+    return;
+  char key[8];
+  sprintf(key, "seq%d", slot);
+  Preferences prefs;
+  if (save)
+  {
+    flashWriteBegin();
+    prefs.begin("synth", false);
+    prefs.putBytes(key, &synth.sequencer.getPattern(), sizeof(SeqPattern));
+    prefs.end();
+    flashWriteEnd();
+  }
+  else
+  {
+    SeqPattern loaded;
+    prefs.begin("synth", true);
+    if (prefs.getBytes(key, &loaded, sizeof(SeqPattern)) == sizeof(SeqPattern))
     {
-      currentState[i] = requestState[i];
-      numVoices--;
-      if (numVoices == 0)
-        handleNoteOff();
+      synth.sequencer.getPattern() = loaded;
+      synth.sequencer.setLength(loaded.length);
+      synth.sequencer.reset();
     }
+    prefs.end();
+  }
+}
+
+//---------------------Benchmarks---------------------------------------
+#ifdef SYNTH_BENCH
+// Built with env:bench: times the DSP blocks before Mozzi starts and prints
+// "bench <name> <cycles> cycles" lines for tools/bench_compare.py
+
+#define benchCalls 2000
+
+volatile int benchSink = 0;
+
+void benchmark(const char *name, void (*body)(int))
+{
+  uint32_t start = ESP.getCycleCount();
+  for (int i = 0; i < benchCalls; i++)
+  {
+    benchSink = i; // same loop overhead as the empty reference below
   }
+  uint32_t overhead = ESP.getCycleCount() - start;
+  start = ESP.getCycleCount();
+  for (int i = 0; i < benchCalls; i++)
+  {
+    body(i);
+  }
+  uint32_t cycles = ESP.getCycleCount() - start;
+  cycles = cycles > overhead ? cycles - overhead : 0;
+  Serial.printf("bench %s %.1f cycles\n", name, (float)cycles / benchCalls);
+}
+
+void runBenchmarks()
+{
+  // heavy patch: filter, both distortions, noise and every modulation source routed
+  synth.FILTERSTATE = 1;
+  synth.PREDISTSTATE = true;
+  synth.POSTDISTSTATE = true;
+  synth.NOISE_LEVEL = 40;
+  synth.ENV2_STATE = synth.NOISEMOD_STATE = true;
+  synth.lfos.setState(0, true);
+  synth.lfos.setState(1, true);
+  synth.env2VarNdx[0] = 7;
+  synth.lfoVarNdx[0][1] = 0;
+  synth.lfoVarNdx[1][2] = 3;
+  synth.noiseVarNdx[3] = 8;
+  synth.handleNoteOn(12);
+  synth.partVoices[0].setLevel(1, 128);
+  synth.partVoices[0].noteOn(60);
+
+  benchmark("distortion", [](int i)
+            { benchSink = distortion((i & 0x3FFF) - 0x2000, 200, true, i & 1); });
+  benchmark("modulator", [](int)
+            { synth.modulator(true, true); });
+  benchmark("lfo_bank", [](int)
+            { synth.lfos.update(); });
+  benchmark("envelope_voice", [](int i)
+            { static BlockEnvelope env(MOZZI_CONTROL_RATE);
+              static GainRamp gains[2];
+              if (i == 0) { env.setLevels(255, 200, 100, 0); env.setTimes(20, 500, 5000, 50); env.noteOn();
+                            gains[0].setBlockSize(128); gains[1].setBlockSize(128); }
+              if ((i & 127) == 0) { env.update();
+                                    gains[0].to((env.value() * 200) >> 8); gains[1].to((env.value() * 100) >> 8); }
+              benchSink = (synth.osc1.next() * gains[0].next() + synth.osc2.next() * gains[1].next()) >> 8; });
+  benchmark("adsr_voice", [](int i)
+            { static ADSR<MOZZI_CONTROL_RATE, MOZZI_AUDIO_RATE> adsr;
+              if (i == 0) { adsr.setLevels(255, 200, 100, 0); adsr.setTimes(20, 500, 5000, 50); adsr.noteOn(); }
+              if ((i & 127) == 0) adsr.update();
+              benchSink = (adsr.next() * ((synth.osc1.next() * 200 + synth.osc2.next() * 100) >> 8)) >> 8; });
+  benchmark("smoother", [](int i)
+            { if ((i & 127) == 0) synth.smoothers[7].setTarget(i & 0xFF);
+              if ((i & (SMOOTH_STEP - 1)) == 0) benchSink = synth.smoothers[7].next(); });
+  benchmark("noise_source", [](int)
+            { benchSink = synth.noise.source().next(); });
+  benchmark("noise_block", [](int)
+            { benchSink = synth.noise.next(); });
+  benchmark("detune", [](int i)
+            { benchSink = (int)SynthEngine::detune(261.6f, (i & 0x1FF) - 255); });
+  benchmark("setFreq", [](int)
+            { synth.setFreq(); });
+  benchmark("checkData_dispatch", [](int)
+            { strcpy(receivedChars, "FILTERRESONANCE:128"); checkData(); });
+  benchmark("param_dispatch", [](int i)
+            { synth.set("FILTERRESONANCE", i & 0xFF); });
+  benchmark("filter", [](int i)
+            { synth.filter.next((i & 0x3FFF) - 0x2000); benchSink = synth.filter.low(); });
+  benchmark("updateControl", [](int)
+            { updateControl(); });
+  benchmark("updateAudio", [](int)
+            { benchSink = updateAudio().l(); });
+  benchmark("engine_control", [](int)
+            { synth.control(); });
+  benchmark("engine_next", [](int)
+            { benchSink = synth.next(); });
+  benchmark("spectrum_tap", [](int i)
+            { spectrum.tap(i); });
+  benchmark("part_voice", [](int)
+            { benchSink = synth.partVoices[0].next(); });
+  benchmark("note_stack_29_keys", [](int i)
+            { static NoteStack stack; stack.update(i & 1 ? keyMask : 0); benchSink = stack.follow(false); });
+  benchmark("sample_voice", [](int)
+            { if (!synth.sampleVoice.active()) synth.sampleVoice.start(synth.samples, 0, 67, true, 0, synth.getRates().audioRate);
+              benchSink = synth.sampleVoice.next(); });
+
+  synth.handleNoteOff();
+  synth.partVoices[0].noteOff();
+  synth.partVoices[0].setLevel(1, 0);
+  synth.FILTERSTATE = 0;
+  synth.PREDISTSTATE = synth.POSTDISTSTATE = false;
+  synth.NOISE_LEVEL = 0;
+  synth.ENV2_STATE = synth.NOISEMOD_STATE = false;
+  synth.lfos.setState(0, false);
+  synth.lfos.setState(1, false);
+  synth.env2VarNdx[0] = synth.lfoVarNdx[0][1] = synth.lfoVarNdx[1][2] = synth.noiseVarNdx[3] = -1;
+  synth.FILTERRESONANCE = 5;
+
+  // the benchmarks ran the live engine: no bench cycles, records or quality
+  // steps may reach the first real control tick (telemetryTask is not started yet)
+  renderCycles = 0;
+  outputPeak = 0;
+  synth.governor.reset();
+  telemetry.reset();
+  // updateAudio() counted renderedSamples but no sample reached audioOutput(): latency traces
+  // compare the two counters, so both start from 0 with Mozzi
+  synth.renderedSamples = 0;
+  outputSamples = 0;
 }
+#endif
 
 //-------------Serial Evaluation-----------------------
 
@@ -638,418 +802,70 @@ void checkSerial()
 void checkData()
 {
   String message = String(receivedChars);
-  Serial.println(message);
   String valName;
   int val;
 
   int colonIndex = message.indexOf(':');
-  Serial.println(message);
 
-  if (colonIndex != -1)
-  {
-    valName = message.substring(0, colonIndex);
-    val = message.substring(colonIndex + 1).toInt();
-  }
-  if (valName == "OSC1_TABLE")
-  {
-    switch (val)
-    {
-    case 0:
-      osc1.setTable(SAW8192_DATA);
-      break;
-    case 1:
-      osc1.setTable(SIN8192_DATA);
-      break;
-    case 2:
-      osc1.setTable(SMOOTHSQUARE8192_DATA);
-      break;
-    case 3:
-      osc1.setTable(TRIANGLE_WARM8192_DATA);
-      break;
-    case 4:
-      osc1.setTable(WHITENOISE8192_DATA);
-      break;
-    default:
-      break;
-    }
-  }
-  if (valName == "OSC2_TABLE")
-  {
-    switch (val)
-    {
-    case 0:
-      osc2.setTable(SAW8192_DATA);
-      break;
-    case 1:
-      osc2.setTable(SIN8192_DATA);
-      break;
-    case 2:
-      osc2.setTable(SMOOTHSQUARE8192_DATA);
-      break;
-    case 3:
-      osc2.setTable(TRIANGLE_WARM8192_DATA);
-      break;
-    case 4:
-      osc2.setTable(WHITENOISE8192_DATA);
-      break;
-    default:
-      break;
-    }
-  }
-  if (valName == "LFO1_TABLE")
-  {
-    switch (val)
-    {
-    case 0:
-      LFO1.setTable(SIN2048_DATA);
-      break;
-    case 1:
-      LFO1.setTable(SAW2048_DATA);
-      break;
-    case 2:
-      LFO1.setTable(SQUARE_NO_ALIAS_2048_DATA);
-      break;
-    case 3:
-      LFO1.setTable(TRIANGLE2048_DATA);
-      break;
-    default:
-      break;
-    }
-  }
-  if (valName == "LFO2_TABLE")
-  {
-    switch (val)
-    {
-    case 0:
-      LFO2.setTable(SIN2048_DATA);
-      break;
-    case 1:
-      LFO2.setTable(SAW2048_DATA);
-      break;
-    case 2:
-      LFO2.setTable(SQUARE_NO_ALIAS_2048_DATA);
-      break;
-    case 3:
-      LFO2.setTable(TRIANGLE2048_DATA);
-      break;
-    default:
-      break;
-    }
-  }
-  if (valName == "SLIDETIME")
-  {
-    slide1.setTime(val);
-    slide2.setTime(val);
-  }
-  if (valName == "OCTAVE")
-  {
-    OCTAVE = val;
-  }
-
-  if (valName == "OSC1_OCT")
-  {
-    OSC1_OCT = val;
-  }
-
-  if (valName == "OSC1_SEMI")
-  {
-    OSC1_SEMI = val;
-  }
-
-  if (valName == "OSC1_LEVEL")
-  {
-    OSC1_LEVEL = val;
-  }
-  if (valName == "OSC1_FINE")
-  {
-    OSC1_FINE = val;
-  }
-
-  if (valName == "OSC2_OCT")
-  {
-    OSC2_OCT = val;
-  }
-
-  if (valName == "OSC1_SEMI")
-  {
-    OSC1_SEMI = val;
-  }
-
-  if (valName == "OSC2_LEVEL")
-  {
-    OSC2_LEVEL = val;
-  }
-
-  if (valName == "OSC2_FINE")
-  {
-    OSC2_FINE = val;
-  }
-
-  if (valName == "NOISE_LEVEL")
-  {
-    NOISE_LEVEL = val;
-  }
-
-  //-------Envelopes----------------------
-  if (valName == "ENV1_AL")
-  {
-    env1.setAttackLevel(val);
-  }
-  if (valName == "ENV1_DL")
-  {
-    env1.setDecayLevel(val);
-  }
-  if (valName == "ENV1_SL")
-  {
-    env1.setSustainLevel(val);
-  }
-  if (valName == "ENV1_RL")
-  {
-    env1.setReleaseLevel(val);
-  }
-  if (valName == "ENV1_A")
-  {
-    env1.setAttackTime(val);
-  }
-  if (valName == "ENV1_D")
-  {
-    env1.setDecayTime(val);
-  }
-  if (valName == "ENV1_S")
-  {
-    env1.setSustainTime(val);
-  }
-  if (valName == "ENV1_R")
-  {
-    env1.setReleaseTime(val);
-  }
-
-  if (valName == "ENV2_STATE")
-  {
-    ENV2_STATE = val;
-  }
-  if (valName == "ENV2_AL")
-  {
-    env2.setAttackLevel(val);
-  }
-  if (valName == "ENV2_DL")
-  {
-    env2.setDecayLevel(val);
-  }
-  if (valName == "ENV2_SL")
-  {
-    env2.setSustainLevel(val);
-  }
-  if (valName == "ENV2_RL")
-  {
-    env2.setReleaseLevel(val);
-  }
-  if (valName == "ENV2_A")
-  {
-    env2.setAttackTime(val);
-  }
-  if (valName == "ENV2_D")
-  {
-    env2.setDecayTime(val);
-  }
-  if (valName == "ENV2_S")
-  {
-    env2.setSustainTime(val);
-  }
-  if (valName == "ENV2_R")
-  {
-    env2.setReleaseTime(val);
-  }
-  if (valName == "LFO1_STATE")
-  {
-    LFO1_STATE = val;
-  }
-  if (valName == "LFO1_FREQ")
-  {
-    LFO1.setFreq(val / 10.0f);
-  }
-
-  if (valName == "LFO2_STATE")
-  {
-    LFO2_STATE = val;
-  }
-  if (valName == "LFO2_FREQ")
-  {
-    LFO2.setFreq(val / 10.0f);
-  }
-
-  // Distortion
-  if (valName == "PREDISTAMOUNT")
-  {
-    PREDISTAMOUNT = val;
-  }
-  if (valName == "PREDISTMODE")
-  {
-    PREDISTMODE = val;
-  }
-  if (valName == "PREDISTSTATE")
-  {
-    PREDISTSTATE = val;
-  }
-
-  if (valName == "POSTDISTAMOUNT")
-  {
-    POSTDISTAMOUNT = val;
-  }
-  if (valName == "POSTDISTMODE")
-  {
-    POSTDISTMODE = val;
-  }
-  if (valName == "POSTDISTSTATE")
-  {
-    POSTDISTSTATE = val;
-  }
-
-  //-------------Filter----------------------
-  if (valName == "FILTERSTATE")
-  {
-    FILTERSTATE = val;
-  }
-  if (valName == "FILTERTYPE")
-  {
-    FILTERTYPE = val;
-  }
-  if (valName == "FILTERCUTOFF")
-  {
-    FILTERCUTOFF = val;
-  }
-  if (valName == "FILTERRESONANCE")
-  {
-    FILTERRESONANCE = val;
-  }
-
-  //--------------Modulator------------------
-  if (message.startsWith("ENVVARNDX"))
-  {
-    if (colonIndex != -1)
-    {
-      String indexStr = message.substring(colonIndex - 1, colonIndex);
-
-      int index = indexStr.toInt();
-
-      if (index >= 0 && index < numModValues)
-      {
-        env2VarNdx[index] = val;
-      }
-    }
-  }
-  if (message.startsWith("ENVAMOUNT_"))
-  {
-    if (colonIndex != -1)
-    {
-      String indexStr = message.substring(colonIndex - 1, colonIndex);
-
-      int index = indexStr.toInt();
-
-      if (index >= 0 && index < numModValues)
-      {
-        env2Amount[index] = val;
-      }
-    }
-  }
-  if (message.startsWith("ENVMODTYPE"))
-  {
-    if (colonIndex != -1)
-    {
-      String indexStr = message.substring(colonIndex - 1, colonIndex);
-
-      int index = indexStr.toInt();
-
-      if (index >= 0 && index < numModValues)
-      {
-        env2ModType[index] = val;
-      }
-    }
-  }
-
-  if (message.startsWith("LFO1VARNDX"))
-  {
-    if (colonIndex != -1)
-    {
-      String indexStr = message.substring(colonIndex - 1, colonIndex);
-
-      int index = indexStr.toInt();
-
-      if (index >= 0 && index < numModValues)
-      {
-        LFO1VarNdx[index] = val;
-      }
-    }
-  }
-  if (message.startsWith("LFO1AMOUNT_"))
-  {
-    if (colonIndex != -1)
-    {
-      String indexStr = message.substring(colonIndex - 1, colonIndex);
-
-      int index = indexStr.toInt();
-
-      if (index >= 0 && index < numModValues)
-      {
-        LFO1Amount[index] = val;
-      }
-    }
-  }
-  if (message.startsWith("LFO1MODTYPE"))
-  {
-    if (colonIndex != -1)
-    {
-      String indexStr = message.substring(colonIndex - 1, colonIndex);
-
-      int index = indexStr.toInt();
-
-      if (index >= 0 && index < numModValues)
-      {
-        LFO1ModType[index] = val;
-      }
-    }
-  }
-
-  if (message.startsWith("LFO2VARNDX"))
-  {
-    if (colonIndex != -1)
-    {
-      String indexStr = message.substring(colonIndex - 1, colonIndex);
-
-      int index = indexStr.toInt();
-
-      if (index >= 0 && index < numModValues)
-      {
-        LFO2VarNdx[index] = val;
-      }
-    }
-  }
-  if (message.startsWith("LFO2AMOUNT_"))
-  {
-    if (colonIndex != -1)
-    {
-      String indexStr = message.substring(colonIndex - 1, colonIndex);
-
-      int index = indexStr.toInt();
-
-      if (index >= 0 && index < numModValues)
-      {
-        LFO2Amount[index] = val;
-      }
-    }
-  }
-  if (message.startsWith("LFO2MODTYPE"))
-  {
-    if (colonIndex != -1)
-    {
-      String indexStr = message.substring(colonIndex - 1, colonIndex);
-
-      int index = indexStr.toInt();
+  if (colonIndex == -1)
+    return;
+  valName = message.substring(0, colonIndex);
+  val = message.substring(colonIndex + 1).toInt();
+  telemetry.push(micros(), telemetryParam, 0, (int16_t)telemetryNameHash(valName.c_str()), val);
+
+  int index = 0;
+  int id = paramId(valName.c_str(), index);
+  if (id == -1)
+    return;
+  if (synth.AUTOMATION_MODE == automationRecord && id >= firstAutomatedParam && id != paramPartOsc1Table &&
+      id != paramPartOsc2Table)
+    synth.recordParam(id, index, val);
+  setParam(id, index, val);
+}
 
-      if (index >= 0 && index < numModValues)
-      {
-        LFO2ModType[index] = val;
-      }
-    }
+// Applies a parameter by id from checkData(): the firmware's own settings here, the patch in synth
+void setParam(int id, int index, int val)
+{
+  switch (id)
+  {
+  case paramLatencyTrace:
+    LATENCY_TRACE = val;
+    latency.clear();
+    break;
+  case paramLatencyReport:
+    printLatencyReport();
+    break;
+  case paramTelemetryMode:
+    TELEMETRY_MODE = val;
+    break;
+  case paramScopeDecimation:
+    SCOPE_DECIMATION = val;
+    scopeCount = 0;
+    break;
+  case paramSpectrumRate:
+    SPECTRUM_RATE = val;
+    break;
+  case paramSpectrumDecimation:
+    SPECTRUM_DECIMATION = constrain(val, 1, 64);
+    spectrum.setDecimation(SPECTRUM_DECIMATION);
+    break;
+  case paramGovernorState:
+    GOVERNOR_STATE = val;
+    if (!GOVERNOR_STATE)
+      synth.governor.reset();
+    break;
+  case paramControlRate:
+    storeControlRate(val);
+    break;
+  case paramSeqSave:
+    seqStore(val, true);
+    break;
+  case paramSeqLoad:
+    seqStore(val, false);
+    break;
+
+  default:
+    synth.setParam(id, index, val);
+    break;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,119 @@
+#ifndef HOSTSYNTH_H
+#define HOSTSYNTH_H
+
+/*  Host build of the synth engine for offline rendering.
+
+    HostSynth is the firmware's SynthEngine (include/SynthEngine.h), given
+    the wave tables the firmware takes from Mozzi: the 8192/2048 cell
+    tables are regenerated here from their shapes, so renders match the
+    firmware up to the table contents. noteOn() / noteOff() press keys
+    like the key scan. Not on the host: the key scan itself, the sample
+    partition (SAMPLE_LEVEL plays nothing without a sample image), latency
+    tracing, telemetry and the spectrum taps. The quality governor is never
+    fed, so host renders run at full quality. Rates are per instance, like
+    the firmware's boot time control rate (HOST_* are the firmware
+    defaults).
+*/
+
+#include <stdint.h>
+#include <math.h>
+#include <string>
+#include "SynthEngine.h"
+
+#define HOST_AUDIO_RATE 32768
+#define HOST_CONTROL_RATE 256
+#define HOST_OSC_CELLS OSC_TABLE_CELLS
+#define HOST_LFO_CELLS 2048
+
+enum hostOscTables
+{
+  hostSaw,
+  hostSin,
+  hostSquare,
+  hostTriangle,
+  hostWhiteNoise,
+  numHostOscTables
+};
+
+struct HostTables
+{
+  int8_t osc[numHostOscTables][HOST_OSC_CELLS];
+  int8_t lfo[4][HOST_LFO_CELLS]; // sin, saw, square, triangle like LFO*_TABLE
+
+  HostTables()
+  {
+    const double pi = 3.14159265358979323846;
+    uint32_t r = 0x9E3779B9UL;
+    for (int i = 0; i < HOST_OSC_CELLS; i++)
+    {
+      double p = (double)i / HOST_OSC_CELLS;
+      osc[hostSaw][i] = (int8_t)lrint(-128.0 + 255.0 * p);
+      osc[hostSin][i] = (int8_t)lrint(127.0 * sin(2 * pi * p));
+      osc[hostSquare][i] = (int8_t)lrint(127.0 * tanh(12.0 * sin(2 * pi * p)));
+      osc[hostTriangle][i] = (int8_t)lrint(127.0 * (2.0 / pi) * asin(sin(2 * pi * p)));
+      r ^= r << 13;
+      r ^= r >> 17;
+      r ^= r << 5;
+      osc[hostWhiteNoise][i] = (int8_t)(r >> 24);
+    }
+    for (int i = 0; i < HOST_LFO_CELLS; i++)
+    {
+      double p = (double)i / HOST_LFO_CELLS;
+      lfo[0][i] = (int8_t)lrint(127.0 * sin(2 * pi * p));
+      lfo[1][i] = (int8_t)lrint(-128.0 + 255.0 * p);
+      lfo[2][i] = p < 0.5 ? 127 : -128;
+      lfo[3][i] = (int8_t)lrint(127.0 * (2.0 / pi) * asin(sin(2 * pi * p)));
+    }
+  }
+};
+
+// Shared read-only tables, build once before starting render threads
+inline const HostTables &hostTables()
+{
+  static const HostTables tables;
+  return tables;
+}
+
+class HostSynth : public SynthEngine
+{
+public:
+  HostSynth(uint32_t audio_rate = HOST_AUDIO_RATE, uint32_t control_rate = HOST_CONTROL_RATE)
+      : SynthEngine(audio_rate, control_rate)
+  {
+    const HostTables &t = hostTables();
+    for (int i = 0; i < numHostOscTables; i++)
+      oscTables[i] = t.osc[i];
+    setWaveTables(oscTables, numHostOscTables);
+    for (uint8_t shape = 0; shape < LFO_TABLE_SHAPES; shape++)
+      lfos.setTable(shape, t.lfo[shape]);
+  }
+
+  using SynthEngine::set;
+
+  bool set(const std::string &name, int val)
+  {
+    return set(name.c_str(), val);
+  }
+
+  // Key note pressed / released, like a key scan seeing it
+  void noteOn(uint8_t note)
+  {
+    setKeys(currentKeys | 1UL << (note + keyNoteOffset));
+  }
+
+  void noteOff(uint8_t note)
+  {
+    setKeys(currentKeys & ~(1UL << (note + keyNoteOffset)));
+  }
+
+  // All keys up
+  void noteOff()
+  {
+    setKeys(0);
+  }
+
+private:
+  const int8_t *oscTables[numHostOscTables];
+};
+
+#endif /* HOSTSYNTH_H */
@@ -0,0 +1,166 @@
+/*  Round trip and size check of the automation stream (include/AutomationStream.h).
+
+    Encodes random event lists and checks that they decode to the same
+    events, then prints the bytes per minute of typical recordings at the
+    firmware audio rate. Exits with 1 on any mismatch.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -Iinclude tools/automation_check.cpp -o automation_check
+      ./automation_check
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "AutomationStream.h"
+#include "SynthParams.h"
+
+#define AUDIO_RATE 32768
+#define CONTROL_RATE 256
+#define BLOCK (AUDIO_RATE / CONTROL_RATE)
+
+static uint32_t rng = 12345;
+
+static uint32_t nextRandom()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static bool roundTrip(const std::vector<AutomationEvent> &events, std::vector<uint8_t> &buffer)
+{
+  AutomationStream stream;
+  stream.begin(buffer.data(), buffer.size());
+  for (const AutomationEvent &e : events)
+  {
+    if (!stream.append(e))
+    {
+      printf("append failed at event %u\n", stream.events());
+      return false;
+    }
+  }
+  // read back through due() the way playAutomation() does: not due one sample early, due on time
+  size_t n = 0;
+  AutomationEvent e = {0, 0, 0, 0};
+  while (n < events.size())
+  {
+    const AutomationEvent &want = events[n];
+    bool early = want.time > 0 && (n == 0 || events[n - 1].time < want.time) && stream.due(want.time - 1);
+    if (early || !stream.due(want.time) || !stream.read(e) || e.time != want.time || e.id != want.id ||
+        e.index != want.index || e.value != want.value)
+    {
+      printf("mismatch at event %zu: got %u %u %u %d\n", n, e.time, e.id, e.index, e.value);
+      return false;
+    }
+    n++;
+  }
+  if (n != events.size() || !stream.finished())
+  {
+    printf("decoded %zu of %zu events\n", n, events.size());
+    return false;
+  }
+  return true;
+}
+
+// Knobs move on control ticks, since checkData() runs from updateControl()
+static std::vector<AutomationEvent> sweep(int knobs, int eventsPerSecond, int seconds, bool notes)
+{
+  std::vector<AutomationEvent> events;
+  uint32_t ticks = (uint32_t)seconds * CONTROL_RATE;
+  uint32_t every = CONTROL_RATE / eventsPerSecond;
+  for (uint32_t tick = 0; tick < ticks; tick++)
+  {
+    uint32_t time = tick * BLOCK;
+    if (notes && tick % (CONTROL_RATE / 2) == 0)
+    {
+      AutomationEvent on = {time, paramNoteOn, 0, (int32_t)(nextRandom() % 24)};
+      events.push_back(on);
+    }
+    if (notes && tick % (CONTROL_RATE / 2) == CONTROL_RATE / 4)
+    {
+      AutomationEvent off = {time, paramNoteOff, 0, 0};
+      events.push_back(off);
+    }
+    if (tick % every == 0)
+    {
+      for (int k = 0; k < knobs; k++)
+      {
+        double phase = (double)tick / CONTROL_RATE * (0.2 + 0.1 * k);
+        AutomationEvent e = {time, (uint8_t)(59 + k), 0, (int32_t)lrint(127.5 + 127.5 * sin(2 * M_PI * phase))};
+        events.push_back(e);
+      }
+    }
+  }
+  return events;
+}
+
+static void report(const char *name, const std::vector<AutomationEvent> &events, int seconds)
+{
+  std::vector<uint8_t> buffer(1 << 20);
+  AutomationStream stream;
+  stream.begin(buffer.data(), buffer.size());
+  for (const AutomationEvent &e : events)
+    stream.append(e);
+  printf("%-40s %7u events %8.0f bytes/minute %5.2f bytes/event\n", name, stream.events(),
+         stream.size() * 60.0 / seconds, stream.events() ? (double)stream.size() / stream.events() : 0.0);
+}
+
+int main()
+{
+  int failed = 0;
+  std::vector<uint8_t> buffer(1 << 20);
+  for (int run = 0; run < 200; run++)
+  {
+    std::vector<AutomationEvent> events;
+    uint32_t time = 0;
+    int count = nextRandom() % 2000;
+    for (int i = 0; i < count; i++)
+    {
+      uint32_t r = nextRandom();
+      time += (r & 3) == 0 ? 0 : nextRandom() % ((r & 4) ? 100000 : 300) * ((r & 8) ? AUTOMATION_COARSE : 1);
+      AutomationEvent e = {time, (uint8_t)nextRandom(), (uint8_t)((r >> 8) & 1 ? nextRandom() % 9 : 0),
+                           (r >> 9) & 1 ? (int32_t)(nextRandom() % 256) : (int32_t)nextRandom()};
+      if ((r >> 10) & 1 && !events.empty()) // same slot as the previous event
+      {
+        e.id = events.back().id;
+        e.index = events.back().index;
+      }
+      events.push_back(e);
+    }
+    failed += !roundTrip(events, buffer);
+  }
+
+  // a full buffer rejects the event without corrupting what is stored
+  std::vector<uint8_t> small(64);
+  AutomationStream full;
+  full.begin(small.data(), small.size());
+  AutomationEvent e = {0, 5, 0, 1000};
+  uint32_t stored = 0;
+  while (full.append(e))
+  {
+    stored++;
+    e.time += 10;
+    e.id = (e.id + 1) & 0x3F;
+  }
+  AutomationEvent back;
+  uint32_t readBack = 0;
+  while (full.read(back))
+    readBack++;
+  if (readBack != stored || full.size() > small.size())
+  {
+    printf("full buffer: stored %u, read %u\n", stored, readBack);
+    failed++;
+  }
+
+  report("1 knob, 30 moves/s", sweep(1, 32, 60, false), 60);
+  report("4 knobs, 30 moves/s each", sweep(4, 32, 60, false), 60);
+  report("1 knob every control tick", sweep(1, CONTROL_RATE, 60, false), 60);
+  report("notes, 2 per second", sweep(0, 1, 60, true), 60);
+  report("notes + 2 knobs, 30 moves/s", sweep(2, 32, 60, true), 60);
+
+  printf(failed ? "FAILED\n" : "round trips ok\n");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,342 @@
+/*  Batch patch renderer for sound design previews and regression sweeps.
+
+    Renders every patch of a patch list to a 16 bit mono WAV at the firmware
+    audio rate, spreading the renders over all cores with a work-stealing
+    pool, and prints peak, RMS, clipped samples and render speed per patch.
+    How the pool scales with the core count has only been measured on a
+    single core host so far: the --sweep took 0.50 s wall on 1 thread and
+    0.52 s on 4, so the pool adds no measurable overhead there, but any
+    speedup on more cores is untested. Compare the wall time of a run with
+    1 thread against one with all cores to measure it.
+
+    Patch list, one patch per line, '#' starts a comment:
+      <name> [GUI_NAME=value ...] [notes=<key>:<ms>,<key>:<ms>,-:<ms>,...]
+    GUI names are the ones checkData() understands (OSC1_TABLE=2,
+    FILTERSTATE=1, LFO1VARNDX0=7, ...). Keys are keyboard notes like
+    handleNoteOn() gets them, each held for <ms>; '-' is a rest.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -pthread -Iinclude -Itools tools/batch_render.cpp -o batch_render
+      ./batch_render patches.txt [out_dir] [threads]
+      ./batch_render --sweep [out_dir] [threads]   (OSC1_TABLE x filter x distortion x routing)
+    See tools/patches_example.txt for a patch list.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "HostSynth.h"
+
+struct NoteStep
+{
+  int key; // -1 for a rest
+  unsigned int ms;
+};
+
+struct Patch
+{
+  std::string name;
+  std::vector<std::pair<std::string, int>> params;
+  std::vector<NoteStep> notes;
+};
+
+struct RenderResult
+{
+  int peak;
+  double rms;
+  unsigned long clipped;
+  unsigned long samples;
+  double seconds;    // rendering only
+  double jobSeconds; // including the WAV write
+  bool ok;
+};
+
+static const char *defaultNotes = "0:400,4:400,7:400,12:800,-:300";
+
+static bool parseNotes(const std::string &text, std::vector<NoteStep> &notes)
+{
+  std::stringstream list(text);
+  std::string item;
+  while (std::getline(list, item, ','))
+  {
+    size_t colon = item.find(':');
+    if (colon == std::string::npos)
+      return false;
+    NoteStep step;
+    step.key = item.compare(0, colon, "-") == 0 ? -1 : atoi(item.substr(0, colon).c_str());
+    step.ms = (unsigned int)atoi(item.substr(colon + 1).c_str());
+    notes.push_back(step);
+  }
+  return true;
+}
+
+static bool parsePatchLine(const std::string &line, Patch &patch)
+{
+  std::stringstream words(line);
+  std::string word;
+  if (!(words >> patch.name))
+    return false;
+  while (words >> word)
+  {
+    size_t eq = word.find('=');
+    if (eq == std::string::npos)
+      return false;
+    std::string key = word.substr(0, eq);
+    std::string value = word.substr(eq + 1);
+    if (key == "notes")
+    {
+      if (!parseNotes(value, patch.notes))
+        return false;
+    }
+    else
+    {
+      patch.params.push_back(std::make_pair(key, atoi(value.c_str())));
+    }
+  }
+  if (patch.notes.empty())
+    parseNotes(defaultNotes, patch.notes);
+  return true;
+}
+
+static std::vector<Patch> sweepPatches()
+{
+  static const char *routings[] = {"", "LFO1_STATE=1 LFO1_FREQ=40 LFO1VARNDX0=7 LFO1AMOUNT_0=200",
+                                   "ENV2_STATE=1 ENVVARNDX0=7 ENVAMOUNT_0=255", "NOISEMOD_STATE=1 NOISEVARNDX0=7 NOISEAMOUNT_0=150"};
+  std::vector<Patch> patches;
+  for (int table = 0; table < numHostOscTables; table++)
+  {
+    for (int filterType = -1; filterType < 4; filterType++)
+    {
+      for (int dist = -1; dist < 2; dist++)
+      {
+        for (int routing = 0; routing < 4; routing++)
+        {
+          std::stringstream line;
+          line << "sweep_t" << table << "_f" << filterType + 1 << "_d" << dist + 1 << "_r" << routing;
+          line << " OSC1_TABLE=" << table;
+          if (filterType >= 0)
+            line << " FILTERSTATE=1 FILTERCUTOFF=120 FILTERRESONANCE=180 FILTERTYPE=" << filterType;
+          if (dist >= 0)
+            line << " PREDISTSTATE=1 PREDISTAMOUNT=200 PREDISTMODE=" << dist;
+          line << " " << routings[routing];
+          Patch patch;
+          parsePatchLine(line.str(), patch);
+          patches.push_back(patch);
+        }
+      }
+    }
+  }
+  return patches;
+}
+
+static void writeLE(FILE *f, uint32_t value, int bytes)
+{
+  for (int i = 0; i < bytes; i++)
+    fputc((value >> (8 * i)) & 0xFF, f);
+}
+
+static bool writeWav(const std::string &path, const std::vector<int16_t> &samples)
+{
+  FILE *f = fopen(path.c_str(), "wb");
+  if (!f)
+    return false;
+  uint32_t dataBytes = samples.size() * 2;
+  fwrite("RIFF", 1, 4, f);
+  writeLE(f, 36 + dataBytes, 4);
+  fwrite("WAVEfmt ", 1, 8, f);
+  writeLE(f, 16, 4);
+  writeLE(f, 1, 2); // PCM
+  writeLE(f, 1, 2); // mono
+  writeLE(f, HOST_AUDIO_RATE, 4);
+  writeLE(f, HOST_AUDIO_RATE * 2, 4);
+  writeLE(f, 2, 2);
+  writeLE(f, 16, 2);
+  fwrite("data", 1, 4, f);
+  writeLE(f, dataBytes, 4);
+  std::vector<uint8_t> bytes(dataBytes);
+  for (size_t i = 0; i < samples.size(); i++)
+  {
+    bytes[2 * i] = (uint16_t)samples[i] & 0xFF;
+    bytes[2 * i + 1] = (uint16_t)samples[i] >> 8;
+  }
+  bool written = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+  return fclose(f) == 0 && written;
+}
+
+static RenderResult render(const Patch &patch, const std::string &outDir)
+{
+  RenderResult result = {0, 0.0, 0, 0, 0.0, 0.0, true};
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  HostSynth synth;
+  for (const std::pair<std::string, int> &p : patch.params)
+  {
+    if (!synth.set(p.first, p.second))
+      fprintf(stderr, "%s: unknown parameter %s\n", patch.name.c_str(), p.first.c_str());
+  }
+
+  // notes change on control ticks, like keys seen by readKeys()
+  const unsigned int blockLen = HOST_AUDIO_RATE / HOST_CONTROL_RATE;
+  std::vector<int16_t> samples;
+  double sumSquares = 0;
+  for (const NoteStep &step : patch.notes)
+  {
+    if (step.key >= 0)
+      synth.noteOn((uint8_t)step.key);
+    unsigned long blocks = ((unsigned long)step.ms * HOST_CONTROL_RATE + 999) / 1000;
+    for (unsigned long b = 0; b < blocks; b++)
+    {
+      synth.control();
+      for (unsigned int i = 0; i < blockLen; i++)
+      {
+        int s = synth.next();
+        int magnitude = s < 0 ? -s : s;
+        if (magnitude > result.peak)
+          result.peak = magnitude;
+        if (s > 32767 || s < -32768)
+        {
+          result.clipped++;
+          s = s > 0 ? 32767 : -32768;
+        }
+        sumSquares += (double)s * s;
+        samples.push_back((int16_t)s);
+      }
+    }
+    if (step.key >= 0)
+      synth.noteOff();
+  }
+  result.samples = samples.size();
+  result.rms = samples.empty() ? 0.0 : sqrt(sumSquares / samples.size());
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.ok = writeWav(outDir + "/" + patch.name + ".wav", samples);
+  result.jobSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+// Each worker pops from the back of its own deque and steals from the front of the others
+class WorkStealingPool
+{
+public:
+  WorkStealingPool(unsigned int workers, size_t jobs) : queues(workers), locks(workers)
+  {
+    for (size_t j = 0; j < jobs; j++)
+      queues[j % workers].push_back(j);
+  }
+
+  bool take(unsigned int self, size_t &job)
+  {
+    {
+      std::lock_guard<std::mutex> guard(locks[self]);
+      if (!queues[self].empty())
+      {
+        job = queues[self].back();
+        queues[self].pop_back();
+        return true;
+      }
+    }
+    for (unsigned int k = 1; k < queues.size(); k++)
+    {
+      unsigned int victim = (self + k) % queues.size();
+      std::lock_guard<std::mutex> guard(locks[victim]);
+      if (!queues[victim].empty())
+      {
+        job = queues[victim].front();
+        queues[victim].pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  std::vector<std::deque<size_t>> queues;
+  std::vector<std::mutex> locks;
+};
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s <patches.txt | --sweep> [out_dir] [threads]\n", argv[0]);
+    return 1;
+  }
+  std::string outDir = argc > 2 ? argv[2] : ".";
+  unsigned int threads = argc > 3 ? (unsigned int)atoi(argv[3]) : std::thread::hardware_concurrency();
+  if (threads == 0)
+    threads = 1;
+
+  std::vector<Patch> patches;
+  if (std::string(argv[1]) == "--sweep")
+  {
+    patches = sweepPatches();
+  }
+  else
+  {
+    std::ifstream in(argv[1]);
+    if (!in)
+    {
+      fprintf(stderr, "cannot open %s\n", argv[1]);
+      return 1;
+    }
+    std::string line;
+    unsigned int lineNo = 0;
+    while (std::getline(in, line))
+    {
+      lineNo++;
+      size_t hash = line.find('#');
+      if (hash != std::string::npos)
+        line.erase(hash);
+      if (line.find_first_not_of(" \t\r") == std::string::npos)
+        continue;
+      Patch patch;
+      if (!parsePatchLine(line, patch))
+      {
+        fprintf(stderr, "%s:%u: cannot parse patch\n", argv[1], lineNo);
+        return 1;
+      }
+      patches.push_back(patch);
+    }
+  }
+
+  hostTables(); // build the shared tables before the workers start
+  std::vector<RenderResult> results(patches.size());
+  WorkStealingPool pool(threads, patches.size());
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (unsigned int w = 0; w < threads; w++)
+  {
+    workers.push_back(std::thread([&, w]()
+                                  {
+                                    size_t job;
+                                    while (pool.take(w, job))
+                                      results[job] = render(patches[job], outDir); }));
+  }
+  for (std::thread &t : workers)
+    t.join();
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("%-32s %8s %9s %8s %9s\n", "patch", "peak", "rms", "clipped", "x realtime");
+  double audioSeconds = 0;
+  double jobSeconds = 0;
+  int failed = 0;
+  for (size_t i = 0; i < patches.size(); i++)
+  {
+    const RenderResult &r = results[i];
+    double length = (double)r.samples / HOST_AUDIO_RATE;
+    audioSeconds += length;
+    jobSeconds += r.jobSeconds;
+    failed += !r.ok;
+    printf("%-32s %8d %9.1f %8lu %9.1f%s\n", patches[i].name.c_str(), r.peak, r.rms, r.clipped,
+           r.seconds > 0 ? length / r.seconds : 0.0, r.ok ? "" : "  (WAV not written)");
+  }
+  printf("%zu patches, %.1f s of audio in %.2f s wall (%.2f s in jobs) on %u threads: %.1f x realtime\n",
+         patches.size(), audioSeconds, wall, jobSeconds, threads, wall > 0 ? audioSeconds / wall : 0.0);
+  return failed ? 1 : 0;
+}
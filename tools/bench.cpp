@@ -0,0 +1,502 @@
+/*  Native microbenchmarks of the DSP building blocks.
+
+    Times each block in a tight loop, BENCH_REPEATS rounds over all blocks
+    in turn, and prints the median per block, the quartiles of the rounds
+    on the next line:
+      bench <name> <ns per call> ns [<cycles per call> cycles]
+    modulator, param_dispatch (paramId() + setParam()), engine_control and
+    engine_next are SynthEngine's own functions, the ones the firmware runs.
+    Then the CPU time of one second of audio with one part, two layered
+    parts and two whole synths, interleaved for PARTS_SECONDS each, and
+    the extra CPU of the second part in percent (median over the rounds,
+    the quartiles on the next line):
+      bench parts_<variant> <us per second of audio> us
+      bench parts_<layer|pipeline>_added <percent> %
+    followed by the rate matrix, the CPU time of one second of audio per
+    audio / control rate combination (median of RATE_CELL_SECONDS of
+    rendering per cell, one second of each cell in turn, about half a
+    minute for the whole matrix):
+      bench rate_<audio>_<control> <us per second of audio> us
+    The same "bench <name> <value> <unit>" lines come from the firmware
+    built with -D SYNTH_BENCH (env:bench), so tools/bench_compare.py can
+    keep a baseline and flag regressions for both; it uses the quartile
+    lines as the noise band of each row.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -Iinclude -Itools tools/bench.cpp -o bench
+      ./bench > bench_native.txt
+      python tools/bench_compare.py bench_native.txt --save   (first run, stores the baseline)
+      python tools/bench_compare.py bench_native.txt          (later runs)
+*/
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <functional>
+#include "HostSynth.h"
+#include "SpectrumAnalyzer.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES 1
+#endif
+
+#define BENCH_CALLS 1000000UL
+#define BENCH_REPEATS 9 // interleaved rounds over all blocks
+#define RATE_CELL_SECONDS 2.0 // wall time per rate matrix cell, interleaved with the others
+#define PARTS_SECONDS 4.0     // wall time per parts variant, interleaved with the others
+
+static volatile int sink; // keeps results alive
+
+// ADSR<CONTROL, AUDIO>, the Mozzi envelope BlockEnvelope replaced: a Line<Q15n16> ramp per
+// phase over ms * rate / 1024 control steps, 8 bit output. Only used to compare CPU time.
+struct HostADSR
+{
+  enum
+  {
+    attack,
+    decay,
+    sustain,
+    release,
+    idle
+  };
+  uint32_t updateSteps[idle + 1];
+  int32_t lerpSteps[idle + 1];
+  uint8_t levels[idle + 1];
+  uint32_t lerpsPerControl;
+  uint32_t rate;
+  uint32_t counter;
+  uint8_t phase;
+  bool playing;
+  int32_t current; // Line<Q15n16>
+  int32_t step;
+
+  HostADSR(uint32_t control_rate, uint32_t audio_rate) : lerpsPerControl(audio_rate / control_rate), rate(control_rate),
+                                                         counter(0), phase(idle), playing(false), current(0), step(0)
+  {
+    for (uint8_t i = 0; i <= idle; i++)
+    {
+      levels[i] = 0;
+      setTime(i, 0);
+    }
+  }
+
+  void setTime(uint8_t p, unsigned int ms)
+  {
+    updateSteps[p] = ((uint32_t)ms * rate) >> 10;
+    lerpSteps[p] = (int32_t)(updateSteps[p] * lerpsPerControl);
+  }
+
+  void setLevels(uint8_t a, uint8_t d, uint8_t s, uint8_t r)
+  {
+    levels[attack] = a;
+    levels[decay] = d;
+    levels[sustain] = s;
+    levels[release] = r;
+  }
+
+  void setTimes(unsigned int a, unsigned int d, unsigned int s, unsigned int r)
+  {
+    setTime(attack, a);
+    setTime(decay, d);
+    setTime(sustain, s);
+    setTime(release, r);
+    setTime(idle, 65535);
+  }
+
+  void setPhase(uint8_t p)
+  {
+    counter = 0;
+    phase = p;
+    int32_t to = (int32_t)levels[p] << 16;
+    if (lerpSteps[p])
+      step = (to - current) / lerpSteps[p];
+    else
+    {
+      step = 0;
+      current = to;
+    }
+  }
+
+  void noteOn()
+  {
+    setPhase(attack);
+    playing = true;
+  }
+
+  void noteOff()
+  {
+    setPhase(release);
+  }
+
+  void update()
+  {
+    if (phase == idle)
+      playing = false;
+    else if (++counter >= updateSteps[phase])
+      setPhase(phase + 1);
+  }
+
+  uint8_t next()
+  {
+    uint8_t out = 0;
+    if (playing)
+    {
+      current += step;
+      out = (uint8_t)(current >> 16);
+    }
+    return out;
+  }
+};
+
+// A block timed by bench(): one call runs the loop once and returns ns and cycles per call
+struct MicroBench
+{
+  std::string name;
+  std::function<void(double &ns, double &cycles)> run;
+};
+
+static std::vector<MicroBench> microBenches;
+
+// Registers a block for runMicroBenches(), which times all of them in interleaved rounds
+template <typename F>
+static void bench(const char *name, F body, unsigned long calls = BENCH_CALLS)
+{
+  MicroBench b;
+  b.name = name;
+  b.run = [body, calls](double &ns, double &cycles) mutable
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#ifdef BENCH_CYCLES
+    unsigned long long c0 = __rdtsc();
+#endif
+    for (unsigned long i = 0; i < calls; i++)
+      body(i);
+#ifdef BENCH_CYCLES
+    cycles = (double)(__rdtsc() - c0) / calls;
+#else
+    cycles = 0;
+#endif
+    ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+  };
+  microBenches.push_back(b);
+}
+
+// Median as the bench line, the quartiles on a line of their own so the spread shows
+static void printMedian(const char *name, std::vector<double> sorted, const char *unit, const char *what,
+                        int decimals)
+{
+  std::sort(sorted.begin(), sorted.end());
+  size_t n = sorted.size();
+  printf("bench %s %.*f %s\n", name, decimals, sorted[n / 2], unit);
+  printf("  %s: %zu %s, quartiles %.*f .. %.*f %s\n", name, n, what, decimals, sorted[n / 4], decimals,
+         sorted[3 * n / 4], unit);
+}
+
+// BENCH_REPEATS rounds over every registered block, so host noise (clock changes, other load)
+// hits all blocks alike instead of whichever happened to run at the time
+static void runMicroBenches()
+{
+  std::vector<std::vector<double>> ns(microBenches.size()), cycles(microBenches.size());
+  double n, c;
+  for (size_t b = 0; b < microBenches.size(); b++) // warm up
+    microBenches[b].run(n, c);
+  for (int repeat = 0; repeat < BENCH_REPEATS; repeat++)
+  {
+    for (size_t b = 0; b < microBenches.size(); b++)
+    {
+      microBenches[b].run(n, c);
+      ns[b].push_back(n);
+      cycles[b].push_back(c);
+    }
+  }
+  for (size_t b = 0; b < microBenches.size(); b++)
+  {
+    printMedian(microBenches[b].name.c_str(), ns[b], "ns", "repeats", 2);
+#ifdef BENCH_CYCLES
+    printMedian((microBenches[b].name + "_cycles").c_str(), cycles[b], "cycles", "repeats", 1);
+#endif
+  }
+}
+
+// Interleaved timing of whole seconds of audio: every round renders one second of each variant, so
+// host noise (clock changes, other load) hits all variants alike. Rounds run until wall_seconds
+// have passed, the per-second times of each variant come back in round order.
+template <typename F>
+static std::vector<std::vector<double>> interleaved(size_t variants, double wall_seconds, F renderSecond)
+{
+  std::vector<std::vector<double>> times(variants);
+  double elapsed = 0;
+  while (elapsed < wall_seconds)
+  {
+    for (size_t v = 0; v < variants; v++)
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      renderSecond(v);
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      times[v].push_back(seconds);
+      elapsed += seconds;
+    }
+  }
+  return times;
+}
+
+static void printSeconds(const char *name, const std::vector<double> &seconds)
+{
+  std::vector<double> us;
+  for (double s : seconds)
+    us.push_back(s * 1e6);
+  printMedian(name, us, "us", "seconds of audio", 1);
+}
+
+// Extra CPU of a variant over the base in percent, per round, so both seconds of a pair saw the same
+// host: the median as the bench line and the quartiles of the rounds on a line of their own
+static void printAdded(const char *name, const std::vector<double> &times, const std::vector<double> &base)
+{
+  std::vector<double> added;
+  for (size_t round = 0; round < times.size(); round++)
+    added.push_back(100.0 * (times[round] - base[round]) / base[round]);
+  std::sort(added.begin(), added.end());
+  size_t n = added.size();
+  printf("bench %s %.1f %%\n", name, added[n / 2]);
+  printf("  %s: %zu rounds, quartiles %.1f .. %.1f %%\n", name, n, added[n / 4], added[3 * n / 4]);
+}
+
+int main()
+{
+  HostSynth synth;
+  synth.set("FILTERSTATE", 1);
+  synth.set("PREDISTSTATE", 1);
+  synth.set("POSTDISTSTATE", 1);
+  synth.set("NOISE_LEVEL", 40);
+  synth.set("ENV2_STATE", 1);
+  synth.set("LFO1_STATE", 1);
+  synth.set("LFO2_STATE", 1);
+  synth.set("NOISEMOD_STATE", 1);
+  synth.set("ENVVARNDX0", 7);
+  synth.set("LFO1VARNDX1", 0);
+  synth.set("LFO2VARNDX2", 3);
+  synth.set("NOISEVARNDX3", 8);
+  synth.noteOn(12);
+  synth.control();
+
+  bench("distortion", [](unsigned long i)
+        { sink = distortion((int)(i & 0x3FFF) - 0x2000, 200, true, i & 1); });
+  bench("modulator", [&](unsigned long)
+        { synth.modulator(true, true); });
+  bench("detune", [](unsigned long i)
+        { sink = (int)SynthEngine::detune(261.6f, (int)(i & 0x1FF) - 255); });
+  bench("param_dispatch", [&](unsigned long i)
+        { synth.set("FILTERRESONANCE", (int)(i & 0xFF)); });
+  MultiFilter filter;
+  filter.setCutoffFreqAndResonance(100, 200);
+  bench("filter", [&](unsigned long i)
+        { filter.next((int)(i & 0x3FFF) - 0x2000); sink = filter.low(); });
+  bench("engine_control", [&](unsigned long)
+        { synth.control(); });
+  bench("engine_next", [&](unsigned long)
+        { sink = synth.next(); });
+
+  // procedural noise against the old table lookup
+  NoiseSource noise;
+  bench("noise_white", [&](unsigned long)
+        { sink = noise.next(); });
+  noise.setType(pinkNoise);
+  bench("noise_pink", [&](unsigned long)
+        { sink = noise.next(); });
+  NoiseBlock noiseBlock;
+  bench("noise_white_block", [&](unsigned long)
+        { sink = noiseBlock.next(); });
+  NoiseBlock pinkBlock;
+  pinkBlock.source().setType(pinkNoise);
+  bench("noise_pink_block", [&](unsigned long)
+        { sink = pinkBlock.next(); });
+  TableOsc noiseTable;
+  noiseTable.setRate(HOST_AUDIO_RATE);
+  noiseTable.setTable(hostTables().osc[hostWhiteNoise]);
+  noiseTable.setFreq((float)HOST_AUDIO_RATE / HOST_OSC_CELLS);
+  bench("noise_table", [&](unsigned long)
+        { sink = noiseTable.next(); });
+
+  // two oscillators under an envelope: the block envelope folded into per-sample gain
+  // ramps against the Mozzi ADSR stepped per sample and multiplied into the mix
+  TableOsc voiceOsc[2];
+  for (uint8_t o = 0; o < 2; o++)
+  {
+    voiceOsc[o].setRate(HOST_AUDIO_RATE);
+    voiceOsc[o].setTable(hostTables().osc[hostSaw]);
+    voiceOsc[o].setFreq(110.0f * (o + 1));
+  }
+  BlockEnvelope env(HOST_CONTROL_RATE);
+  env.setLevels(255, 200, 100, 0);
+  env.setTimes(20, 500, 5000, 50);
+  env.noteOn();
+  GainRamp gains[2];
+  gains[0].setBlockSize(HOST_AUDIO_RATE / HOST_CONTROL_RATE);
+  gains[1].setBlockSize(HOST_AUDIO_RATE / HOST_CONTROL_RATE);
+  bench("envelope_voice", [&](unsigned long i)
+        {
+          if ((i & 0x1FFFF) == 0) // a note every 4 s, so the envelope keeps moving
+            env.noteOn();
+          if ((i & 127) == 0)
+          {
+            env.update();
+            gains[0].to(((int32_t)env.value() * 200) >> 8);
+            gains[1].to(((int32_t)env.value() * 100) >> 8);
+          }
+          sink = (voiceOsc[0].next() * gains[0].next() + voiceOsc[1].next() * gains[1].next()) >> 8; });
+  HostADSR adsr(HOST_CONTROL_RATE, HOST_AUDIO_RATE);
+  adsr.setLevels(255, 200, 100, 0);
+  adsr.setTimes(20, 500, 5000, 50);
+  adsr.noteOn();
+  bench("adsr_voice", [&](unsigned long i)
+        {
+          if ((i & 0x1FFFF) == 0)
+            adsr.noteOn();
+          if ((i & 127) == 0)
+            adsr.update();
+          sink = (adsr.next() * ((voiceOsc[0].next() * 200 + voiceOsc[1].next() * 100) >> 8)) >> 8; });
+
+  // voice of a layered part, oscillators and envelope, then with its own filter swept by LFO 1
+  PartVoice part, filteredPart;
+  for (PartVoice *v : {&part, &filteredPart})
+  {
+    v->setTable(0, hostTables().osc[hostSaw]);
+    v->setTable(1, hostTables().osc[hostSaw]);
+    v->setLevel(1, 128);
+    v->noteOn(60);
+  }
+  filteredPart.setCutoff(100);
+  filteredPart.setResonance(150);
+  filteredPart.setLfoCutoff(80);
+  bench("part_voice", [&](unsigned long i)
+        { if ((i & 127) == 0) part.update(0); sink = part.next(); });
+  bench("part_voice_filtered", [&](unsigned long i)
+        { if ((i & 127) == 0) filteredPart.update((int)((i >> 7) & 0xFF) - 128); sink = filteredPart.next(); });
+
+  // one control block of the LFO bank: 2 and 8 LFOs over every shape
+  LfoBank<2> lfos2;
+  LfoBank<8> lfos8;
+  for (uint8_t shape = 0; shape < LFO_TABLE_SHAPES; shape++)
+  {
+    lfos2.setTable(shape, hostTables().lfo[shape]);
+    lfos8.setTable(shape, hostTables().lfo[shape]);
+  }
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    lfos8.setShape(i, i % numLfoShapes);
+    lfos8.setRate(i, 100 + 7919 * i); // 0.1 Hz .. 55 Hz
+    lfos8.setPhaseOffset(i, i * 32);
+  }
+  lfos8.setSync(7, lfoSyncSixteenth);
+  bench("lfo_bank_2", [&](unsigned long)
+        { lfos2.update(); sink = lfos2.value(1); });
+  bench("lfo_bank_8", [&](unsigned long)
+        { lfos8.update(); sink = lfos8.value(7); });
+
+  // one analyzer frame: 512 taps, window, FFT and bands
+  static SpectrumAnalyzer<512> spectrum;
+  spectrum.setDecimation(1);
+  uint8_t bands[SPECTRUM_BANDS];
+  int8_t scope[SPECTRUM_SCOPE_POINTS];
+  bench("spectrum_frame", [&](unsigned long i)
+        {
+          for (int n = 0; n < 512; n++)
+            spectrum.tap((int16_t)((n * 37 + i) * 97));
+          spectrum.process(bands, scope);
+          sink = bands[5]; },
+        2000);
+  runMicroBenches();
+
+  // CPU time for one second of audio: one part, a second part layered in the shared render pass,
+  // and for comparison two whole synths (a second full pipeline), interleaved like the rate matrix.
+  // The *_added lines are the extra CPU of the second part over one part.
+  static const char *const partNames[] = {"parts_1", "parts_2_layered", "parts_2_pipelines"};
+  std::vector<HostSynth *> partSynths; // two per variant, the second one only plays in parts_2_pipelines
+  for (int variant = 0; variant < 3; variant++)
+  {
+    for (int p = 0; p < 2; p++)
+    {
+      HostSynth *synth = new HostSynth();
+      synth->set("FILTERSTATE", 1);
+      synth->set("PREDISTSTATE", 1);
+      synth->set("POSTDISTSTATE", 1);
+      synth->set("OSC2_LEVEL", 128);
+      synth->set("ENV2_STATE", 1);
+      synth->set("LFO1_STATE", 1);
+      synth->set("ENVVARNDX0", 7);
+      synth->set("LFO1VARNDX1", 0);
+      partSynths.push_back(synth);
+    }
+    if (variant == 1)
+    {
+      partSynths[2]->set("PART_MODE", partLayer);
+      partSynths[2]->set("PART_OSC2_LEVEL2", 128);
+      partSynths[2]->set("PART_OCT2", -1);
+    }
+  }
+  std::vector<std::vector<double>> partSeconds = interleaved(3, PARTS_SECONDS * 3, [&](size_t v)
+                                                             {
+    HostSynth &first = *partSynths[2 * v];
+    HostSynth &second = *partSynths[2 * v + 1];
+    first.noteOff();
+    first.noteOn(12);
+    second.noteOff();
+    second.noteOn(0);
+    for (uint32_t tick = 0; tick < HOST_CONTROL_RATE; tick++)
+    {
+      first.control();
+      if (v == 2)
+        second.control();
+      for (uint32_t i = 0; i < HOST_AUDIO_RATE / HOST_CONTROL_RATE; i++)
+        sink = v == 2 ? first.next() + second.next() : first.next();
+    } });
+  for (size_t v = 0; v < 3; v++)
+    printSeconds(partNames[v], partSeconds[v]);
+  printAdded("parts_layer_added", partSeconds[1], partSeconds[0]);
+  printAdded("parts_pipeline_added", partSeconds[2], partSeconds[0]);
+  for (HostSynth *synth : partSynths)
+    delete synth;
+
+  // CPU time for one second of the heavy patch per rate combination, interleaved over the matrix
+  static const uint32_t audioRates[] = {16384, 32768, 48000};
+  static const uint32_t controlRates[] = {64, 128, 256, 512, 1024};
+  std::vector<HostSynth *> rated;
+  std::vector<std::string> names;
+  for (uint32_t audioRate : audioRates)
+  {
+    for (uint32_t controlRate : controlRates)
+    {
+      HostSynth *synth = new HostSynth(audioRate, controlRate);
+      synth->set("FILTERSTATE", 1);
+      synth->set("PREDISTSTATE", 1);
+      synth->set("POSTDISTSTATE", 1);
+      synth->set("NOISE_LEVEL", 40);
+      synth->set("ENV2_STATE", 1);
+      synth->set("LFO1_STATE", 1);
+      synth->set("ENVVARNDX0", 7);
+      synth->set("LFO1VARNDX1", 0);
+      rated.push_back(synth);
+      names.push_back("rate_" + std::to_string(audioRate) + "_" + std::to_string(controlRate));
+    }
+  }
+  std::vector<std::vector<double>> rateSeconds = interleaved(rated.size(), RATE_CELL_SECONDS * rated.size(), [&](size_t v)
+                                                             {
+    HostSynth &synth = *rated[v];
+    synth.noteOff();
+    synth.noteOn(12); // every second from the attack, so the envelope does the same work
+    const SynthRates &r = synth.getRates();
+    for (uint32_t tick = 0; tick < r.controlRate; tick++)
+    {
+      synth.control();
+      for (uint32_t i = 0; i < r.blockSize; i++)
+        sink = synth.next();
+    } });
+  for (size_t v = 0; v < rated.size(); v++)
+  {
+    printSeconds(names[v].c_str(), rateSeconds[v]);
+    delete rated[v];
+  }
+  return 0;
+}
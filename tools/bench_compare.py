@@ -0,0 +1,108 @@
+"""Benchmark baseline and regression check.
+
+Reads "bench <name> <value> <unit>" lines (from tools/bench.cpp or from the
+firmware's SYNTH_BENCH serial output, other lines are ignored), then either
+stores them as the baseline or compares them against it. Lower is better.
+
+    python tools/bench_compare.py run.txt --save [--baseline FILE]
+    python tools/bench_compare.py run.txt [--baseline FILE] [--threshold PERCENT] [--points POINTS]
+
+The value of a row is the median of its repeats. Where the run also printed
+"  <name>: ... quartiles <low> .. <high> <unit>", that range is the row's
+noise band: a row only counts as slower when it is more than the threshold
+(default 10 %) slower AND its band lies wholly above the baseline's, so a
+noisy host does not flag rows whose repeats still overlap. Rows in "%" are
+differences of two other rows and get an absolute tolerance instead
+(--points, default 5 percentage points), with the same band test. Rows
+without quartiles (the firmware's cycle counts) use the threshold alone.
+
+Exits with 1 when any benchmark got slower.
+"""
+
+import argparse
+import re
+import sys
+
+QUARTILES = re.compile(r"^\s+(\S+): .*quartiles (\S+) \.\. (\S+)")
+
+
+def read_results(path):
+    results = {}
+    bands = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            match = QUARTILES.match(line)
+            if match:
+                try:
+                    bands[match.group(1)] = (float(match.group(2)), float(match.group(3)))
+                except ValueError:
+                    pass
+                continue
+            words = line.split()
+            if len(words) >= 4 and words[0] == "bench":
+                try:
+                    results[words[1]] = (float(words[2]), words[3])
+                except ValueError:
+                    pass
+    return {name: (value, unit, bands.get(name)) for name, (value, unit) in results.items()}
+
+
+def slower(value, unit, band, old, old_band, args):
+    """Change for the report and whether it is a regression."""
+    if unit == "%":
+        change = value - old
+        over = change > args.points
+    else:
+        change = (value - old) / old * 100.0 if old else 0.0
+        over = change > args.threshold
+    if over and band and old_band and band[0] <= old_band[1]:
+        return change, False  # the repeats overlap: within the noise of the two runs
+    return change, over
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("results")
+    parser.add_argument("--baseline", default="bench_baseline.txt")
+    parser.add_argument("--save", action="store_true", help="store the results as the new baseline")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed slowdown in percent")
+    parser.add_argument("--points", type=float, default=5.0, help="allowed rise of %% rows in percentage points")
+    args = parser.parse_args()
+
+    results = read_results(args.results)
+    if not results:
+        sys.exit("no bench lines in " + args.results)
+
+    if args.save:
+        with open(args.baseline, "w") as f:
+            for name, (value, unit, band) in sorted(results.items()):
+                f.write("bench %s %g %s\n" % (name, value, unit))
+                if band:
+                    f.write("  %s: quartiles %g .. %g %s\n" % (name, band[0], band[1], unit))
+        print("saved %d results to %s" % (len(results), args.baseline))
+        return 0
+
+    baseline = read_results(args.baseline)
+    regressions = 0
+    print("%-24s %12s %12s %8s" % ("benchmark", "baseline", "now", "change"))
+    for name, (value, unit, band) in sorted(results.items()):
+        if name not in baseline:
+            print("%-24s %12s %12g %8s  new" % (name, "-", value, unit))
+            continue
+        old, _, old_band = baseline[name]
+        change, regression = slower(value, unit, band, old, old_band, args)
+        flag = ""
+        if regression:
+            flag = "  REGRESSION"
+            regressions += 1
+        if unit == "%":
+            print("%-24s %12g %12g %+6.1fpt%s" % (name, old, value, change, flag))
+        else:
+            print("%-24s %12g %12g %+7.1f%%%s" % (name, old, value, change, flag))
+    for name in sorted(set(baseline) - set(results)):
+        print("%-24s %12g %12s %8s  missing" % (name, baseline[name][0], "-", ""))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,186 @@
+/*  Segment timing check of include/BlockEnvelope.h.
+
+    Runs the envelope the way the firmware does, update() and value() once
+    per control block, at control rates 64..1024 Hz and segment times from
+    1 ms to 10 s, and checks every segment: it ends within one control
+    block of its time in ms (the first block of the next phase), its last
+    block value is the level it aims at, and on the way there it only
+    moves towards that level. Then checks that GainRamp lands on each
+    block's gain. Then checks a release started in the
+    middle of the attack and a legato noteOn while the gate is held. Exits
+    with 1 on any failure.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -Iinclude tools/envelope_check.cpp -o envelope_check
+      ./envelope_check
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "BlockEnvelope.h"
+
+#define AUDIO_RATE 32768
+
+static int failed = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL: %s\n", what);
+    failed++;
+  }
+}
+
+struct Segment
+{
+  long samples;  // length of the phase
+  int endValue;  // last block value of the phase
+  bool monotonic;
+};
+
+// Renders whole blocks until the phase changes, the change shows up in the block that ends the segment
+static Segment runPhase(BlockEnvelope &env, unsigned int blockSize, int from, int to)
+{
+  Segment s = {0, from, true};
+  uint8_t phase = env.getPhase();
+  int last = from;
+  int direction = to > from ? 1 : (to < from ? -1 : 0);
+  bool done = false;
+  while (!done && s.samples < 20L * AUDIO_RATE)
+  {
+    env.update();
+    done = env.getPhase() != phase;
+    int v = env.value();
+    // never away from the target, and never past it
+    if ((v - last) * direction < 0 || (v - to) * direction > 0)
+      s.monotonic = false;
+    last = v;
+    s.samples += blockSize;
+  }
+  s.endValue = last;
+  return s;
+}
+
+static void checkTiming(unsigned int controlRate)
+{
+  static const unsigned int times[] = {1, 3, 7, 20, 50, 133, 500, 1000, 5000, 10000};
+  static const uint8_t levels[4] = {255, 160, 100, 0};
+  static const char *const names[] = {"attack", "decay", "sustain", "release"};
+  unsigned int blockSize = AUDIO_RATE / controlRate;
+  int worstError = 0, worstEnd = 0, wrong = 0;
+  for (unsigned int t : times)
+  {
+    BlockEnvelope env(controlRate);
+    env.setLevels(levels[0], levels[1], levels[2], levels[3]);
+    env.setTimes(t, t, t, t);
+    env.restart();
+    int from = 0;
+    for (uint8_t p = envAttack; p <= envRelease; p++)
+    {
+      check(env.getPhase() == p, "phase order");
+      int to = levels[p] * 257;
+      Segment s = runPhase(env, blockSize, from, to);
+      long want = (long)t * AUDIO_RATE / 1000;
+      int error = (int)labs(s.samples - want);
+      int endError = abs(s.endValue - to);
+      if (error > worstError)
+        worstError = error;
+      if (endError > worstEnd)
+        worstEnd = endError;
+      if (error > (int)blockSize || endError > 0 || !s.monotonic)
+      {
+        printf("  %4u Hz %5u ms %-7s: %ld samples, want %ld, ends at %d, want %d%s\n", controlRate, t, names[p],
+               s.samples, want, s.endValue, to, s.monotonic ? "" : ", not monotonic");
+        wrong++;
+      }
+      from = to;
+    }
+    check(!env.playing(), "idle after the release");
+  }
+  printf("%4u Hz control rate: worst segment end %4d samples off (block %4u), worst end value %d off, %d wrong\n",
+         controlRate, worstError, blockSize, worstEnd, wrong);
+  check(wrong == 0, "segment timing");
+}
+
+// noteOff in the middle of the attack releases from where the attack got to
+static void checkEarlyRelease()
+{
+  BlockEnvelope env(256);
+  env.setLevels(255, 160, 100, 0);
+  env.setTimes(1000, 200, 2000, 300);
+  env.restart();
+  int v = 0;
+  for (int block = 0; block < 128; block++) // half the attack
+  {
+    env.update();
+    v = env.value();
+  }
+  check(v > 0 && v < 255 * 257, "attack half way");
+  env.noteOff();
+  check(env.getPhase() == envRelease, "noteOff in the attack starts the release");
+  Segment s = runPhase(env, 128, v, 0);
+  long want = 300L * AUDIO_RATE / 1000;
+  printf("release from %d in the attack: %ld samples (want %ld), ends at %d\n", v, s.samples, want, s.endValue);
+  check(labs(s.samples - want) <= 128 && s.endValue <= 1 && s.monotonic, "release from the attack");
+}
+
+// Legato: noteOn while the gate is held keeps the phase, after the release it retriggers
+static void checkLegato()
+{
+  BlockEnvelope env(256);
+  env.setLevels(255, 160, 100, 0);
+  env.setTimes(10, 200, 2000, 100);
+  env.setMode(envLegato);
+  env.restart();
+  runPhase(env, 128, 0, 255 * 257);
+  check(env.getPhase() == envDecay, "decay after the attack");
+  env.noteOn();
+  check(env.getPhase() == envDecay, "legato noteOn keeps the decay");
+  env.noteOff();
+  env.noteOn();
+  check(env.getPhase() == envAttack, "noteOn in the release retriggers");
+}
+
+// The voice gain ramps from one block value to the next: monotonic inside the block and
+// at most one 16.8 step per sample short of the new value at its end, for any block size
+static void checkGainRamp()
+{
+  static const int32_t gains[] = {0, 65535, 65280, -65535, 1, 0, 32768, 40000, -3};
+  int worst = 0, wrong = 0;
+  for (uint16_t blockSize = 16; blockSize <= 768; blockSize = blockSize * 3 / 2)
+  {
+    GainRamp ramp;
+    ramp.setBlockSize(blockSize);
+    int32_t last = 0;
+    for (int32_t gain : gains)
+    {
+      ramp.to(gain);
+      int32_t v = last;
+      for (uint16_t i = 0; i < blockSize; i++)
+      {
+        int32_t n = ramp.next();
+        check((n - v) * (gain - last) >= 0, "gain ramp moves away from its target");
+        v = n;
+      }
+      int error = abs(v - gain);
+      worst = error > worst ? error : worst;
+      if (error > (blockSize >> 8) + 1)
+        wrong++;
+      last = v;
+    }
+  }
+  printf("gain ramp: block end at most %d off\n", worst);
+  check(wrong == 0, "gain ramp misses the block gain");
+}
+
+int main()
+{
+  for (unsigned int rate = 64; rate <= 1024; rate *= 2)
+    checkTiming(rate);
+  checkEarlyRelease();
+  checkLegato();
+  checkGainRamp();
+  printf(failed ? "FAILED\n" : "envelope ok\n");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,197 @@
+"""IRAM / DRAM / flash usage per subsystem.
+
+Runs after every firmware build as a PlatformIO extra script
+(extra_scripts = post:tools/footprint.py) and prints a table for the
+current env, also written to <build dir>/footprint.txt so envs and
+commits can be compared without hardware.
+
+The report also lists every IRAM function that calls into flash code,
+directly (call0/4/8/12) or through a literal (l32r + callx), because such a
+call stalls on a flash cache miss and faults while the cache is off for a
+flash write. The per-symbol IRAM listing goes to footprint.txt, and to the
+console with --symbols.
+
+Standalone use on an existing ELF:
+    python tools/footprint.py .pio/build/<env>/firmware.elf [objdump] [--symbols]
+"""
+
+import bisect
+import os
+import re
+import subprocess
+import sys
+
+# First matching pattern wins, checked against the demangled symbol name
+SUBSYSTEMS = [
+    ("tables", re.compile(r"_DATA$|oscTables")),
+    ("audio", re.compile(r"updateAudio|audioOutput|SynthEngine::next|distortion|TableOsc|MultiFilter|"
+                         r"NoiseSource|NoiseBlock|BlockEnvelope|SampleVoice|PartVoice|LatencyTrace|outputGain")),
+    ("control", re.compile(r"updateControl|SynthEngine::(control|modulator|smoothTo|setFreq|detune|handleNote|"
+                           r"glideTo|setKeys|playPart|runSequencer|seq|playAutomation)|readKeys|writeKeys|Glide|"
+                           r"QualityGovernor|LfoBank|StepClock")),
+    ("gui", re.compile(r"checkData|checkSerial|receivedChars|setParam|paramId|paramNames")),
+    ("engine", re.compile(r"^synth$|SynthEngine")),  # the engine object: patch state and RAM wave tables
+    ("telemetry", re.compile(r"[Tt]elemetry")),
+    ("mozzi", re.compile(r"[Mm]ozzi|audioHook|MozziPrivate")),
+    ("arduino", re.compile(r"Serial|SPI|HardwareSerial|String|digital|pinMode|uart|spi")),
+]
+
+REGIONS = ("IRAM", "DRAM", "flash")
+
+SYMBOL_LINE = re.compile(r"^([0-9a-fA-F]+)\s.{7}\s(\S+)\s+([0-9a-fA-F]+)\s+(.*)$")
+FUNCTION_LINE = re.compile(r"^([0-9a-fA-F]+) <(.+)>:$")
+CALL_LINE = re.compile(r"^\s*([0-9a-fA-F]+):\s.*\s(call(?:0|4|8|12)|l32r)\s+(?:a\d+,\s*)?([0-9a-fA-F]+)\b")
+DUMP_LINE = re.compile(r"^ ([0-9a-fA-F]+) ((?:[0-9a-fA-F]{2,8} ?){1,4})")
+IRAM_TEXT = ".iram0.text"
+
+
+def region_of(section):
+    if section.startswith(".iram"):
+        return "IRAM"
+    if section.startswith((".dram", ".data", ".bss", ".noinit")):
+        return "DRAM"
+    if section.startswith(".flash"):
+        return "flash"
+    return None
+
+
+def subsystem_of(name):
+    for subsystem, pattern in SUBSYSTEMS:
+        if pattern.search(name):
+            return subsystem
+    return "other"
+
+
+def run(objdump, *args):
+    return subprocess.run([objdump] + list(args), check=True, capture_output=True, text=True).stdout
+
+
+def symbols(elf, objdump):
+    """(address, size, section, name) of every sized symbol."""
+    result = []
+    for line in run(objdump, "-t", "-C", elf).splitlines():
+        match = SYMBOL_LINE.match(line)
+        if match and int(match.group(3), 16):
+            result.append((int(match.group(1), 16), int(match.group(3), 16), match.group(2), match.group(4)))
+    return result
+
+
+def collect(syms):
+    usage = {}
+    for _, size, section, name in syms:
+        region = region_of(section)
+        if region is None:
+            continue
+        row = usage.setdefault(subsystem_of(name), dict.fromkeys(REGIONS, 0))
+        row[region] += size
+    return usage
+
+
+def section_words(elf, objdump, section):
+    """Little endian 32 bit words of a section by address, for resolving l32r literals."""
+    data = {}
+    for line in run(objdump, "-s", "-j", section, elf).splitlines():
+        match = DUMP_LINE.match(line)
+        if not match:
+            continue
+        address = int(match.group(1), 16)
+        raw = bytes.fromhex(match.group(2).replace(" ", ""))
+        for offset in range(len(raw)):
+            data[address + offset] = raw[offset]
+    return data
+
+
+def flash_calls(elf, objdump, syms):
+    """(IRAM caller, flash callee) pairs."""
+    flash = sorted((address, address + size, name) for address, size, section, name in syms
+                   if section.startswith(".flash.text"))
+    starts = [f[0] for f in flash]
+
+    def flash_function(address):
+        i = bisect.bisect_right(starts, address) - 1
+        return flash[i][2] if i >= 0 and address < flash[i][1] else None
+
+    try:
+        disassembly = run(objdump, "-d", "-C", "-j", IRAM_TEXT, elf)
+        memory = section_words(elf, objdump, IRAM_TEXT)
+    except subprocess.CalledProcessError:
+        return set()  # no IRAM text section
+    calls = set()
+    caller = "?"
+    for line in disassembly.splitlines():
+        match = FUNCTION_LINE.match(line)
+        if match:
+            caller = match.group(2)
+            continue
+        match = CALL_LINE.match(line)
+        if not match:
+            continue
+        target = int(match.group(3), 16)
+        if match.group(2) == "l32r":  # the literal holds the address, a callx follows
+            word = [memory.get(target + i) for i in range(4)]
+            if None in word:
+                continue
+            target = int.from_bytes(bytes(word), "little")
+        callee = flash_function(target)
+        if callee:
+            calls.add((caller, callee))
+    return calls
+
+
+def format_symbols(syms):
+    lines = ["IRAM symbols", "%10s  %s" % ("bytes", "symbol")]
+    for _, size, section, name in sorted(syms, key=lambda s: -s[1]):
+        if region_of(section) == "IRAM":
+            lines.append("%10d  %s" % (size, name))
+    return "\n".join(lines)
+
+
+def format_calls(calls):
+    if not calls:
+        return "IRAM -> flash: none"
+    lines = ["IRAM -> flash: %d calls" % len(calls)]
+    for caller, callee in sorted(calls):
+        lines.append("  %s -> %s" % (caller, callee))
+    return "\n".join(lines)
+
+
+def format_report(usage, title):
+    lines = [title, "%-10s %10s %10s %10s" % (("subsystem",) + REGIONS)]
+    totals = dict.fromkeys(REGIONS, 0)
+    for subsystem in sorted(usage, key=lambda s: -sum(usage[s].values())):
+        row = usage[subsystem]
+        lines.append("%-10s %10d %10d %10d" % ((subsystem,) + tuple(row[r] for r in REGIONS)))
+        for region in REGIONS:
+            totals[region] += row[region]
+    lines.append("%-10s %10d %10d %10d" % (("total",) + tuple(totals[r] for r in REGIONS)))
+    return "\n".join(lines)
+
+
+def report(elf, objdump, title, out_file=None, show_symbols=False):
+    syms = symbols(elf, objdump)
+    text = format_report(collect(syms), title) + "\n\n" + format_calls(flash_calls(elf, objdump, syms))
+    listing = format_symbols(syms)
+    print(text)
+    if show_symbols:
+        print("\n" + listing)
+    if out_file:
+        with open(out_file, "w") as f:
+            f.write(text + "\n\n" + listing + "\n")
+
+
+if __name__ == "__main__":
+    args = [a for a in sys.argv[1:] if a != "--symbols"]
+    if not args:
+        sys.exit(__doc__)
+    report(args[0], args[1] if len(args) > 1 else "objdump", "Footprint of " + args[0],
+           show_symbols="--symbols" in sys.argv)
+else:
+    Import("env")  # noqa: F821 (provided by PlatformIO / SCons)
+
+    def footprint_action(target, source, env):
+        elf = str(target[0])
+        objdump = re.sub(r"gcc(\.exe)?$", r"objdump\1", env.subst("$CC"))
+        report(elf, objdump, "Footprint of env:" + env.subst("$PIOENV"),
+               os.path.join(env.subst("$BUILD_DIR"), "footprint.txt"))
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", footprint_action)  # noqa: F821
@@ -0,0 +1,144 @@
+/*  Step-down, hysteresis and step-up check of include/QualityGovernor.h.
+
+    Feeds the governor synthetic load traces, one render time per block
+    against a block time of 1000, the way updateControl() feeds it CPU
+    cycles: a sustained overload steps down one rung every few blocks to the
+    bottom, a single missed deadline counts at once, a load between the
+    marks holds the level however long it lasts, a light load steps back up
+    after the recovery wait, a patch toggling right at the limit doubles
+    that wait on every step down that follows a step up, and reset() starts
+    over from a clean state. Exits with 1 on any failure.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -Iinclude tools/governor_check.cpp -o governor_check
+      ./governor_check
+*/
+
+#include <stdio.h>
+#include "QualityGovernor.h"
+
+#define BLOCK_TIME 1000
+
+static int failed = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL: %s\n", what);
+    failed++;
+  }
+}
+
+// Blocks of the same load (percent of the block time) until the level changes, 0 when it never does
+static int run(QualityGovernor &governor, int percent, int blocks)
+{
+  for (int block = 1; block <= blocks; block++)
+  {
+    if (governor.update(percent * BLOCK_TIME / 100, BLOCK_TIME))
+      return block;
+  }
+  return 0;
+}
+
+static void checkStepDown()
+{
+  QualityGovernor governor;
+  int first = run(governor, 95, 1000);
+  printf("95 %% load: first step down after %d blocks\n", first);
+  check(first > 0 && first < 16 && governor.getLevel() == qualityNoParts, "step down under overload");
+  int steps = 1;
+  while (run(governor, 95, 16))
+    steps++;
+  check(steps == numQualityLevels - 1 && governor.getLevel() == numQualityLevels - 1, "steps down to the bottom rung");
+  check(!governor.allows(qualityNoParts) && !governor.allows(qualityNoSmoothing), "bottom rung allows nothing");
+  check(run(governor, 200, 1000) == 0 && governor.getLevel() == numQualityLevels - 1, "stays at the bottom");
+
+  // one block past its deadline is over the high mark whatever the smoothed load says
+  QualityGovernor spike;
+  run(spike, 30, 100);
+  int missed = 0;
+  for (int block = 0; block < 2; block++)
+    missed += spike.update(2 * BLOCK_TIME, BLOCK_TIME);
+  check(missed == 1 && spike.getLevel() == qualityNoParts, "missed deadlines step down");
+}
+
+static void checkHysteresis()
+{
+  QualityGovernor governor;
+  check(run(governor, 95, 1000) > 0, "overload");
+  // between the 60 % and 85 % marks nothing changes
+  check(run(governor, 75, 100000) == 0 && governor.getLevel() == qualityNoParts, "load between the marks holds");
+  // brief dips below the low mark do not add up to a step up
+  for (int i = 0; i < 100; i++)
+  {
+    check(run(governor, 40, 200) == 0, "short dip");
+    run(governor, 75, 10);
+  }
+  check(governor.getLevel() == qualityNoParts, "dips between held loads");
+  // the smoothed load filters single heavy blocks under the deadline
+  for (int i = 0; i < 1000; i++)
+  {
+    check(!governor.update(99 * BLOCK_TIME / 100, BLOCK_TIME), "single heavy block");
+    run(governor, 70, 7);
+  }
+}
+
+static void checkStepUp()
+{
+  QualityGovernor governor;
+  while (run(governor, 95, 16))
+    ;
+  int first = run(governor, 30, 100000);
+  printf("30 %% load: first step up after %d blocks\n", first);
+  check(first >= 256 && first < 280 && governor.getLevel() == numQualityLevels - 2, "step up after the recovery wait");
+  int steps = 1;
+  while (run(governor, 30, 300))
+    steps++;
+  check(steps == numQualityLevels - 1 && governor.getLevel() == qualityFull && governor.allows(qualityNoSmoothing),
+        "steps up to full quality");
+
+  // a patch right at the limit: full quality overloads, one rung down is light enough.
+  // Every step down right after a step up doubles the wait before the next try.
+  QualityGovernor edge;
+  int waits[4];
+  for (int i = 0; i < 4; i++)
+  {
+    run(edge, 95, 100);
+    check(edge.getLevel() == qualityNoParts, "edge step down");
+    waits[i] = run(edge, 30, 100000);
+  }
+  printf("toggling patch: recovery waits %d %d %d %d blocks\n", waits[0], waits[1], waits[2], waits[3]);
+  check(waits[0] >= 256 && waits[1] >= 2 * 256 && waits[2] >= 4 * 256 && waits[3] >= 8 * 256, "recovery wait doubles");
+}
+
+static void checkReset()
+{
+  QualityGovernor governor;
+  for (int i = 0; i < 3; i++)
+  {
+    run(governor, 95, 100);
+    run(governor, 30, 100000);
+  }
+  run(governor, 95, 16);
+  check(governor.getLevel() != qualityFull && governor.getLoad() > 80, "loaded before reset");
+  governor.reset();
+  check(governor.getLevel() == qualityFull && governor.getLoad() == 0, "reset clears level and load");
+  // no smoothed load left over: a light block right after the reset is light
+  check(!governor.update(BLOCK_TIME / 2, BLOCK_TIME) && governor.getLoad() < 20, "no load left after reset");
+  // and no recent step up: the first step down does not double the wait
+  run(governor, 95, 100);
+  int wait = run(governor, 30, 100000);
+  printf("after reset: recovery wait %d blocks\n", wait);
+  check(wait >= 256 && wait < 280, "reset restores the recovery wait");
+}
+
+int main()
+{
+  checkStepDown();
+  checkHysteresis();
+  checkStepUp();
+  checkReset();
+  printf(failed ? "FAILED\n" : "governor ok\n");
+  return failed ? 1 : 0;
+}
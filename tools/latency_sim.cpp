@@ -0,0 +1,130 @@
+/*  Host simulation of the key-to-DAC pipeline, using the same LatencyTrace
+    as the firmware, so output buffer or rate changes can be compared offline.
+
+    Model: the loop renders samples as soon as the output buffer has room,
+    running updateControl() (and with it the key scan) before every
+    audioRate / controlRate samples. The DAC takes one sample per audio
+    period. Keys close at random gaps longer than the whole pipeline, so
+    every event is traced. Each event is stamped with its key closure
+    time, not the scan that sees it, so the histogram shows the wait for
+    the next scan as well: the latencies spread over one scan period plus
+    up to one control block of rendering. Exits with 1 when events are
+    skipped or the spread is outside that window.
+
+    Build and run from the project root:
+      g++ -O2 -Iinclude tools/latency_sim.cpp -o latency_sim
+      ./latency_sim [audio_rate] [control_rate] [buffer_size] [render_us] [control_us] [events]
+    Defaults match the firmware: 32768 256 256 8 60 2000
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "LatencyTrace.h"
+
+#define MAX_PENDING 8 // key closures seen by one scan
+
+static uint32_t rng = 0x12345678UL;
+
+static uint32_t randomRange(uint32_t lo, uint32_t hi)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return lo + rng % (hi - lo + 1);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long audioRate = argc > 1 ? strtoul(argv[1], NULL, 10) : 32768;
+  unsigned long controlRate = argc > 2 ? strtoul(argv[2], NULL, 10) : 256;
+  unsigned long bufferSize = argc > 3 ? strtoul(argv[3], NULL, 10) : 256;
+  double renderUs = argc > 4 ? atof(argv[4]) : 8.0;
+  double controlUs = argc > 5 ? atof(argv[5]) : 60.0;
+  unsigned long events = argc > 6 ? strtoul(argv[6], NULL, 10) : 2000;
+
+  if (audioRate == 0 || controlRate == 0 || controlRate > audioRate || bufferSize == 0)
+  {
+    fprintf(stderr, "invalid rates or buffer size\n");
+    return 1;
+  }
+
+  const unsigned long blockLen = audioRate / controlRate;
+  const double samplePeriodUs = 1e6 / audioRate;
+
+  LatencyTrace latency;
+  const uint32_t gapUs = 2 * (uint32_t)((bufferSize + blockLen) * samplePeriodUs) + 10000;
+  double nextKeyUs = randomRange(gapUs, gapUs + 40000);
+  unsigned long keysSent = 0;
+  unsigned long keysPending = 0;
+  uint32_t pendingUs[MAX_PENDING];
+  unsigned long underruns = 0;
+  double renderClock = 0;
+  uint32_t emitted = 0;
+
+  for (uint32_t k = 0; latency.getStats().count + latency.getStats().skipped < events; k++)
+  {
+    // buffer slot for sample k frees up when sample k - bufferSize leaves
+    double now = k >= bufferSize ? (k - bufferSize) * samplePeriodUs : 0;
+    if (renderClock > now)
+      now = renderClock;
+
+    // DAC writes that happened up to now
+    while (emitted < k && emitted * samplePeriodUs <= now)
+    {
+      latency.output(emitted, (uint32_t)(emitted * samplePeriodUs));
+      emitted++;
+    }
+
+    if (k % blockLen == 0)
+    {
+      while (keysSent < events && nextKeyUs <= now)
+      {
+        if (keysPending < MAX_PENDING)
+          pendingUs[keysPending++] = (uint32_t)nextKeyUs;
+        keysSent++;
+        nextKeyUs += randomRange(gapUs, gapUs + 40000);
+      }
+      // one scan sees every change since the last one, each counts as a note event from its key closure
+      for (unsigned long i = 0; i < keysPending; i++)
+        latency.scanned(pendingUs[i]);
+      keysPending = 0;
+      now += controlUs;
+    }
+
+    if (latency.getState() == latencyScanned)
+      latency.rendered(k, (uint32_t)now);
+    now += renderUs;
+    renderClock = now;
+    if (now > k * samplePeriodUs && k >= bufferSize)
+      underruns++;
+  }
+
+  const LatencyStats &stats = latency.getStats();
+  printf("audio %lu Hz, control %lu Hz, buffer %lu samples\n", audioRate, controlRate, bufferSize);
+  printf("Latency: %lu events, %lu skipped, %lu underruns\n", (unsigned long)stats.count, (unsigned long)stats.skipped, underruns);
+  if (stats.count == 0)
+    return 0;
+  printf("min %lu us, mean %lu us, max %lu us, mean key->render %lu us\n",
+         (unsigned long)stats.minUs, (unsigned long)(stats.sumUs / stats.count), (unsigned long)stats.maxUs,
+         (unsigned long)(stats.sumScanToRenderUs / stats.count));
+  printf("p50 <%lu us, p99 <%lu us\n", (unsigned long)latency.percentileUs(500), (unsigned long)latency.percentileUs(990));
+  uint8_t buckets = 0;
+  for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+  {
+    if (stats.histogram[i])
+    {
+      printf("%5u us: %lu\n", i * LATENCY_BUCKET_US, (unsigned long)stats.histogram[i]);
+      buckets++;
+    }
+  }
+
+  // key closures are uniform over the scan period, the block rendered after the scan adds up to its own time
+  const double scanUs = 1e6 / controlRate;
+  const double spreadUs = stats.maxUs - stats.minUs;
+  const double windowUs = scanUs + blockLen * (renderUs + controlUs / blockLen);
+  printf("spread %.0f us over %u buckets, scan period %.0f us, window %.0f us\n", spreadUs, buckets, scanUs, windowUs);
+  bool ok = stats.skipped == 0 && spreadUs >= 0.9 * scanUs && spreadUs <= windowUs &&
+            buckets * LATENCY_BUCKET_US >= 0.9 * scanUs && stats.histogram[LATENCY_BUCKETS - 1] == 0;
+  printf(ok ? "latency ok\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
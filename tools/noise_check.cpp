@@ -0,0 +1,269 @@
+/*  Spectrum and timing check of include/NoiseSource.h.
+
+    White noise: no repeat where the old WHITENOISE8192 table looped, flat
+    within 1 dB per octave, and the xorshift period of 2^32 - 1 samples
+    (the run takes a few seconds). Pink noise: the octave band levels fall
+    by 3 dB per octave (+-1 dB) over the Voss-McCartney range. Sample &
+    hold: the value only changes on multiples of the rate and does change
+    on almost all of them. Crackle: the mean impulse spacing is the rate.
+    White and pink are checked both from next() and from the NoiseBlock the
+    audio path reads, whose fill() uses each xorshift step for several
+    samples; for sample & hold and crackle NoiseBlock must give the same
+    stream as next(). Exits with 1 on any failure.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -Iinclude tools/noise_check.cpp -o noise_check
+      ./noise_check
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include <complex>
+#include <vector>
+#include "NoiseSource.h"
+
+#define SAMPLE_RATE 32768
+#define FFT_SIZE 4096
+#define SEGMENTS 256
+
+static int failed = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL: %s\n", what);
+    failed++;
+  }
+}
+
+static void fft(std::vector<std::complex<double>> &x)
+{
+  size_t n = x.size();
+  for (size_t i = 1, j = 0; i < n; i++)
+  {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j)
+      std::swap(x[i], x[j]);
+  }
+  for (size_t len = 2; len <= n; len <<= 1)
+  {
+    std::complex<double> w = std::polar(1.0, -2 * M_PI / len);
+    for (size_t i = 0; i < n; i += len)
+    {
+      std::complex<double> v = 1;
+      for (size_t k = 0; k < len / 2; k++, v *= w)
+      {
+        std::complex<double> a = x[i + k], b = x[i + k + len / 2] * v;
+        x[i + k] = a + b;
+        x[i + k + len / 2] = a - b;
+      }
+    }
+  }
+}
+
+// Mean power in the octave bands starting at 64 Hz, averaged Hann periodograms, in dB
+template <typename Noise>
+static std::vector<double> octaveBands(Noise &noise)
+{
+  std::vector<double> power(FFT_SIZE / 2, 0);
+  std::vector<std::complex<double>> x(FFT_SIZE);
+  for (int s = 0; s < SEGMENTS; s++)
+  {
+    for (int i = 0; i < FFT_SIZE; i++)
+      x[i] = noise.next() * (0.5 - 0.5 * cos(2 * M_PI * i / FFT_SIZE));
+    fft(x);
+    for (int i = 0; i < FFT_SIZE / 2; i++)
+      power[i] += std::norm(x[i]);
+  }
+  std::vector<double> bands;
+  for (double low = 64; low * 2 <= SAMPLE_RATE / 2; low *= 2)
+  {
+    int from = (int)(low * FFT_SIZE / SAMPLE_RATE), to = (int)(2 * low * FFT_SIZE / SAMPLE_RATE);
+    double sum = 0;
+    for (int i = from; i < to; i++)
+      sum += power[i];
+    bands.push_back(10 * log10(sum / (to - from)));
+  }
+  return bands;
+}
+
+static void printBands(const char *name, const std::vector<double> &bands)
+{
+  printf("%-6s", name);
+  for (double b : bands)
+    printf(" %6.1f", b - bands[0]);
+  printf("  dB, octaves from 64 Hz\n");
+}
+
+static void checkFlat(const char *name, const std::vector<double> &bands)
+{
+  printBands(name, bands);
+  double lowest = 1e9, highest = -1e9;
+  for (double b : bands)
+  {
+    lowest = b < lowest ? b : lowest;
+    highest = b > highest ? b : highest;
+  }
+  check(highest - lowest < 1.0, "white noise not flat");
+}
+
+static void checkWhite()
+{
+  NoiseSource noise;
+  std::vector<int8_t> first(8192 + 64);
+  for (int8_t &v : first)
+    v = noise.next();
+  bool repeats = true;
+  for (int i = 0; i < 64; i++)
+    repeats &= first[i] == first[8192 + i];
+  check(!repeats, "white noise repeats after 8192 samples");
+
+  NoiseSource white;
+  checkFlat("white", octaveBands(white));
+  NoiseBlock whiteBlock;
+  checkFlat("block", octaveBands(whiteBlock));
+
+  // a full xorshift period later the stream starts over, filled in blocks like the audio
+  // path, where each step gives 4 samples
+  NoiseSource period;
+  int8_t start[16], block[NOISE_BLOCK];
+  for (int8_t &v : start)
+    v = period.next();
+  uint64_t left = 4 * (0xFFFFFFFFULL - 16);
+  while (left >= NOISE_BLOCK)
+  {
+    period.fill(block, NOISE_BLOCK);
+    left -= NOISE_BLOCK;
+  }
+  period.fill(block, (uint16_t)left);
+  bool same = true;
+  for (int8_t v : start)
+    same &= period.next() == v;
+  printf("white  period 2^32 - 1 steps: %s\n", same ? "yes" : "no");
+  check(same, "white noise period");
+}
+
+// least squares slope over 128 Hz .. 8 kHz, the rows cover fs / 256 upwards
+static void checkSlope(const char *name, const std::vector<double> &bands)
+{
+  printBands(name, bands);
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  int n = 0;
+  for (size_t i = 1; i + 1 < bands.size(); i++, n++)
+  {
+    sx += i;
+    sy += bands[i];
+    sxx += (double)i * i;
+    sxy += i * bands[i];
+  }
+  double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+  printf("%-6s slope %.2f dB per octave\n", name, slope);
+  check(fabs(slope + 3.0) <= 1.0, "pink noise slope");
+}
+
+static void checkPink()
+{
+  NoiseSource noise;
+  noise.setType(pinkNoise);
+  checkSlope("pink", octaveBands(noise));
+  NoiseBlock block;
+  block.source().setType(pinkNoise);
+  checkSlope("block", octaveBands(block));
+
+  // odd block lengths fall back to nextPink() for the odd sample and stay in range
+  NoiseSource odd;
+  odd.setType(pinkNoise);
+  int8_t buf[NOISE_BLOCK];
+  double sum = 0, squares = 0;
+  uint32_t samples = 0;
+  for (int i = 0; i < 100000; i++)
+  {
+    uint16_t n = 1 + i % NOISE_BLOCK;
+    odd.fill(buf, n);
+    for (uint16_t k = 0; k < n; k++)
+    {
+      sum += buf[k];
+      squares += (double)buf[k] * buf[k];
+    }
+    samples += n;
+  }
+  double rms = sqrt(squares / samples - (sum / samples) * (sum / samples));
+  printf("pink   odd blocks rms %.1f\n", rms);
+  check(rms > 10 && rms < 40, "pink noise level with odd blocks");
+}
+
+static void checkHold()
+{
+  static const uint16_t rates[] = {1, 16, 64, 1000};
+  for (uint16_t rate : rates)
+  {
+    NoiseSource noise;
+    noise.setType(sampleHoldNoise);
+    noise.setRate(rate);
+    int8_t last = noise.next();
+    uint32_t early = 0, changes = 0, boundaries = 0;
+    for (uint32_t i = 1; i < 1000000; i++)
+    {
+      int8_t v = noise.next();
+      if (i % rate == 0)
+      {
+        boundaries++;
+        changes += v != last;
+      }
+      else
+      {
+        early += v != last;
+      }
+      last = v;
+    }
+    printf("hold   rate %4u: %u of %u boundaries changed, %u changes in between\n", rate, changes, boundaries, early);
+    check(early == 0 && changes > boundaries * 0.98, "sample & hold length");
+  }
+}
+
+static void checkCrackle()
+{
+  static const uint16_t rates[] = {16, 256};
+  for (uint16_t rate : rates)
+  {
+    NoiseSource noise;
+    noise.setType(crackleNoise);
+    noise.setRate(rate);
+    uint32_t impulses = 0, calls = 4000000;
+    for (uint32_t i = 0; i < calls; i++)
+      impulses += noise.next() != 0;
+    double spacing = (double)calls / impulses;
+    printf("crackle rate %3u: mean spacing %.1f\n", rate, spacing);
+    check(fabs(spacing / rate - 1) < 0.05, "crackle spacing"); // 1 in 256 impulses is a zero value
+  }
+}
+
+static void checkBlock()
+{
+  for (uint8_t type = sampleHoldNoise; type <= crackleNoise; type++)
+  {
+    NoiseSource single;
+    NoiseBlock block;
+    single.setType(type);
+    block.source().setType(type);
+    bool same = true;
+    for (int i = 0; i < 10 * NOISE_BLOCK + 7; i++)
+      same &= single.next() == block.next();
+    check(same, "NoiseBlock differs from next()");
+  }
+}
+
+int main()
+{
+  checkBlock();
+  checkHold();
+  checkCrackle();
+  checkPink();
+  checkWhite();
+  printf(failed ? "FAILED\n" : "noise ok\n");
+  return failed ? 1 : 0;
+}
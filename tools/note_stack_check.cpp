@@ -0,0 +1,229 @@
+/*  Mono key handling check of include/NoteStack.h.
+
+    Plays fast chord rolls into NoteStack the way writeKeys() does, one key
+    mask per scan, with several keys changing within one scan and across
+    scans, and checks the sounding note and the voice actions for last,
+    low and high note priority with legato and retrigger: every press of a
+    note that wins starts or glides to it, releasing the sounding note
+    falls back to the one the priority picks from the keys still held, and
+    the voice stops only when the last key is released. Then compares a
+    million random scans against a plain list model. Exits with 1 on any
+    failure.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -Iinclude tools/note_stack_check.cpp -o note_stack_check
+      ./note_stack_check
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include "NoteStack.h"
+
+static int failed = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL: %s\n", what);
+    failed++;
+  }
+}
+
+// The mono voice behind the stack
+struct Voice
+{
+  int note;
+  int starts, glides, stops;
+
+  Voice() : note(NOTE_NONE), starts(0), glides(0), stops(0)
+  {
+  }
+
+  void apply(NoteStack &stack, bool legato)
+  {
+    switch (stack.follow(legato))
+    {
+    case noteStart:
+      starts++;
+      note = stack.sounding();
+      break;
+    case noteGlide:
+      check(note != NOTE_NONE, "glide without a sounding note");
+      glides++;
+      note = stack.sounding();
+      break;
+    case noteStop:
+      check(note != NOTE_NONE, "stop without a sounding note");
+      stops++;
+      note = NOTE_NONE;
+      break;
+    default:
+      break;
+    }
+  }
+};
+
+static uint32_t bit(int note)
+{
+  return 1UL << note;
+}
+
+// C major up the keyboard and back, one key per scan, each pressed before the previous one is released
+static void checkRoll(uint8_t priority, bool legato)
+{
+  static const int notes[] = {4, 8, 11, 16, 20, 23, 28};
+  static const char *const names[] = {"last", "low", "high"};
+  NoteStack stack;
+  stack.setPriority(priority);
+  Voice voice;
+  uint32_t keys = 0;
+  int wrong = 0;
+  for (int n : notes)
+  {
+    keys |= bit(n);
+    stack.update(keys);
+    voice.apply(stack, legato);
+    int want = priority == priorityLow ? notes[0] : n; // rolling up, the newest key is also the highest
+    wrong += voice.note != want;
+  }
+  int pressStarts = voice.starts, pressGlides = voice.glides;
+  // release from the top: each release drops the sounding note in last / high priority
+  for (int i = 6; i > 0; i--)
+  {
+    keys &= ~bit(notes[i]);
+    stack.update(keys);
+    voice.apply(stack, legato);
+    wrong += voice.note != (priority == priorityLow ? notes[0] : notes[i - 1]);
+  }
+  keys = 0;
+  stack.update(keys);
+  voice.apply(stack, legato);
+  wrong += voice.note != NOTE_NONE;
+  int changes = priority == priorityLow ? 1 : 13; // sounding notes, 7 up and 6 back down
+  int wantStarts = legato ? 1 : changes;
+  printf("roll %-4s %-9s  %2d starts %2d glides %d stops, %d wrong notes\n", names[priority],
+         legato ? "legato" : "retrigger", voice.starts, voice.glides, voice.stops, wrong);
+  check(wrong == 0, "roll note");
+  check(voice.starts == wantStarts && voice.starts + voice.glides == changes && voice.stops == 1, "roll actions");
+  check(pressStarts + pressGlides == (priority == priorityLow ? 1 : 7), "roll presses");
+}
+
+// Several keys in one scan: releases apply first, presses count from low to high
+static void checkSameScan()
+{
+  NoteStack stack;
+  Voice voice;
+  stack.update(bit(5) | bit(9) | bit(2));
+  voice.apply(stack, false);
+  check(voice.note == 9 && voice.starts == 1, "chord in one scan, last priority");
+  stack.update(bit(2) | bit(12)); // 5 and 9 up, 12 down in the same scan
+  voice.apply(stack, false);
+  check(voice.note == 12 && voice.starts == 2, "release and press in one scan");
+  stack.update(bit(2));
+  voice.apply(stack, false);
+  check(voice.note == 2 && voice.starts == 3, "falls back past notes released in an earlier scan");
+  stack.setPriority(priorityHigh);
+  stack.update(bit(2) | bit(30) | bit(0));
+  voice.apply(stack, true);
+  check(voice.note == 30 && voice.glides == 1, "high priority legato");
+  stack.setPriority(priorityLow); // switching priority while held moves the voice
+  voice.apply(stack, true);
+  check(voice.note == 0 && voice.glides == 2, "priority change while held");
+  stack.update(0);
+  voice.apply(stack, true);
+  check(voice.note == NOTE_NONE && voice.stops == 1 && stack.size() == 0, "all released");
+
+  // a key released and pressed again moves to the top of the last note order
+  stack.setPriority(priorityLast);
+  stack.update(bit(3));
+  stack.update(bit(3) | bit(7));
+  stack.update(bit(7));
+  stack.update(bit(3) | bit(7));
+  stack.update(bit(3));
+  check(stack.current() == 3, "repressed key");
+  stack.update(bit(3) | bit(7));
+  stack.update(bit(7));
+  check(stack.current() == 7 && stack.size() == 1, "repressed key released");
+
+  // silence() hands the voice back, the held note starts again
+  voice = Voice();
+  stack.clear();
+  stack.update(bit(10));
+  voice.apply(stack, true);
+  stack.silence();
+  voice.note = NOTE_NONE;
+  stack.update(bit(10) | bit(11));
+  voice.apply(stack, true);
+  check(voice.note == 11 && voice.starts == 2 && voice.glides == 0, "silence");
+}
+
+// Plain reference: press order list
+static int modelNote(const std::vector<int> &order, uint8_t priority)
+{
+  if (order.empty())
+    return NOTE_NONE;
+  if (priority == priorityLow)
+    return *std::min_element(order.begin(), order.end());
+  if (priority == priorityHigh)
+    return *std::max_element(order.begin(), order.end());
+  return order.back();
+}
+
+static void checkRandom()
+{
+  srand(1);
+  int wrong = 0;
+  long events = 0;
+  for (uint8_t priority = priorityLast; priority <= priorityHigh; priority++)
+  {
+    NoteStack stack;
+    stack.setPriority(priority);
+    std::vector<int> order;
+    uint32_t keys = 0;
+    for (int scan = 0; scan < 1000000; scan++)
+    {
+      // fast rolls: up to 3 keys change per scan, biased to few held keys
+      uint32_t next = keys;
+      int changes = 1 + rand() % 3;
+      for (int c = 0; c < changes; c++)
+      {
+        int n = rand() % 29;
+        if (__builtin_popcount(next) > 6 && !(next & bit(n)))
+          continue;
+        next ^= bit(n);
+      }
+      for (int n = 0; n < 32; n++) // the same order update() applies them
+      {
+        if ((keys & bit(n)) && !(next & bit(n)))
+          order.erase(std::find(order.begin(), order.end(), n));
+      }
+      for (int n = 0; n < 32; n++)
+      {
+        if (!(keys & bit(n)) && (next & bit(n)))
+          order.push_back(n);
+      }
+      events += __builtin_popcount(keys ^ next);
+      keys = next;
+      stack.update(keys);
+      wrong += stack.current() != modelNote(order, priority) || stack.size() != order.size() || stack.mask() != keys;
+    }
+  }
+  printf("random scans: %ld key events, %d mismatches\n", events, wrong);
+  check(wrong == 0, "random scans against the model");
+}
+
+int main()
+{
+  for (uint8_t priority = priorityLast; priority <= priorityHigh; priority++)
+  {
+    checkRoll(priority, false);
+    checkRoll(priority, true);
+  }
+  checkSameScan();
+  checkRandom();
+  printf(failed ? "FAILED\n" : "note stack ok\n");
+  return failed ? 1 : 0;
+}
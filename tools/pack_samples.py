@@ -0,0 +1,108 @@
+"""Sample partition packer for the flash sample voice (include/SampleVoice.h).
+
+Packs WAV files (8/16/24/32 bit PCM, mono or stereo, any sample rate; stereo
+is mixed to mono) into one image for the "samples" data partition. Each
+argument is a WAV file, optionally followed by the root note and the loop
+points in frames:
+
+    python tools/pack_samples.py -o samples.bin kick.wav snare.wav:60 pad.wav:48:1200:35000
+
+The sample number on the GUI (<SAMPLE_INDEX:n>) is the argument order. The
+image is written to the partition offset from partitions_samples.csv:
+
+    esptool.py --chip esp32s3 write_flash 0xC10000 samples.bin
+
+Exits with 1 when a file can't be read or the image does not fit.
+"""
+
+import argparse
+import struct
+import sys
+import wave
+
+MAGIC = b"SMPL"
+VERSION = 1
+LOOP = 0x01
+HEADER = struct.Struct("<4sHHII")  # SampleImageHeader
+ENTRY = struct.Struct("<IIIIIBBH")  # SampleEntry
+PARTITION_SIZE = 0x3E0000  # samples partition in partitions_samples.csv
+
+
+def read_wav(path):
+    """Returns (sample rate, list of 16 bit mono frames)."""
+    with wave.open(path, "rb") as w:
+        channels, width, rate, frames = w.getnchannels(), w.getsampwidth(), w.getframerate(), w.getnframes()
+        compressed = w.getcomptype() != "NONE"
+        raw = w.readframes(frames)
+    if compressed or width not in (1, 2, 3, 4):
+        raise ValueError("only uncompressed PCM is supported")
+    out = []
+    step = width * channels
+    for i in range(0, len(raw) - step + 1, step):
+        total = 0
+        for c in range(channels):
+            b = raw[i + c * width:i + (c + 1) * width]
+            if width == 1:
+                v = (b[0] - 128) << 8  # 8 bit WAV is unsigned
+            else:
+                v = int.from_bytes(b, "little", signed=True) >> (8 * (width - 2))
+            total += v
+        out.append(max(-32768, min(32767, total // channels)))
+    return rate, out
+
+
+def parse_spec(spec):
+    # a Windows drive letter ("C:\...") is not a root note
+    parts = spec.split(":")
+    if len(parts) > 1 and len(parts[0]) == 1 and parts[1].startswith(("\\", "/")):
+        parts = [parts[0] + ":" + parts[1]] + parts[2:]
+    path = parts[0]
+    root = int(parts[1]) if len(parts) > 1 and parts[1] else 60
+    loop = (int(parts[2]), int(parts[3])) if len(parts) > 3 else None
+    return path, root, loop
+
+
+def pack(specs, max_size):
+    entries = []
+    data = bytearray()
+    table_end = HEADER.size + ENTRY.size * len(specs)
+    for spec in specs:
+        path, root, loop = parse_spec(spec)
+        rate, frames = read_wav(path)
+        if not frames:
+            raise ValueError(path + ": no frames")
+        if loop and not (0 <= loop[0] < loop[1] <= len(frames)):
+            raise ValueError("%s: loop %d..%d outside of %d frames" % (path, loop[0], loop[1], len(frames)))
+        while (table_end + len(data)) % 4:
+            data.append(0)
+        offset = table_end + len(data)
+        data += struct.pack("<%dh" % len(frames), *frames)
+        flags = LOOP if loop else 0
+        loop_start, loop_end = loop if loop else (0, 0)
+        entries.append(ENTRY.pack(offset, len(frames), loop_start, loop_end, rate, root & 0x7F, flags, 0))
+        print("%2d %-32s %7d frames %6d Hz root %3d%s" % (len(entries) - 1, path, len(frames), rate, root,
+                                                           " loop %d..%d" % loop if loop else ""))
+    size = table_end + len(data)
+    if size > max_size:
+        raise ValueError("image is %d bytes, the partition holds %d" % (size, max_size))
+    return HEADER.pack(MAGIC, VERSION, len(entries), size, 0) + b"".join(entries) + bytes(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("samples", nargs="+", help="file.wav[:root note[:loop start:loop end]]")
+    parser.add_argument("-o", "--output", default="samples.bin")
+    parser.add_argument("--max-size", type=lambda s: int(s, 0), default=PARTITION_SIZE, help="partition size in bytes")
+    args = parser.parse_args()
+
+    try:
+        image = pack(args.samples, args.max_size)
+    except (OSError, ValueError, wave.Error) as e:
+        sys.exit(str(e))
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print("%s: %d bytes, %.1f %% of the partition" % (args.output, len(image), 100.0 * len(image) / args.max_size))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,257 @@
+/*  Playback check of the flash sample voice (include/SampleVoice.h).
+
+    Builds sample images in memory with the layout of tools/pack_samples.py
+    and checks SampleVoice against the source frames: bit exact at the
+    root note, every other frame an octave up, the 16.16 linear
+    interpolation at other pitches and rates, the start point, sustain
+    loops and release, and that malformed images are rejected. With an
+    image file as argument it also checks every sample of a packed
+    partition image. Exits with 1 on any failure.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -Iinclude tools/sample_check.cpp -o sample_check
+      ./sample_check [samples.bin]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "SampleVoice.h"
+
+#define AUDIO_RATE 32768
+
+static int failed = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL: %s\n", what);
+    failed++;
+  }
+}
+
+struct Source
+{
+  std::vector<int16_t> frames;
+  uint32_t rate;
+  uint8_t root;
+  bool loop;
+  uint32_t loopStart, loopEnd;
+};
+
+static std::vector<uint8_t> buildImage(const std::vector<Source> &sources)
+{
+  uint32_t offset = sizeof(SampleImageHeader) + sources.size() * sizeof(SampleEntry);
+  std::vector<SampleEntry> entries;
+  for (const Source &s : sources)
+  {
+    offset = (offset + 3) & ~3U;
+    SampleEntry e = {offset, (uint32_t)s.frames.size(), s.loopStart, s.loopEnd, s.rate, s.root,
+                     (uint8_t)(s.loop ? SAMPLE_LOOP : 0), 0};
+    entries.push_back(e);
+    offset += s.frames.size() * 2;
+  }
+  std::vector<uint8_t> image(offset, 0);
+  SampleImageHeader header = {SAMPLE_MAGIC, SAMPLE_VERSION, (uint16_t)sources.size(), offset, 0};
+  memcpy(image.data(), &header, sizeof(header));
+  memcpy(image.data() + sizeof(header), entries.data(), entries.size() * sizeof(SampleEntry));
+  for (size_t i = 0; i < sources.size(); i++)
+    memcpy(image.data() + entries[i].offset, sources[i].frames.data(), sources[i].frames.size() * 2);
+  return image;
+}
+
+// Reference of next(): linear interpolation at the exact 16.16 phase, holding the last frame
+static int32_t reference(const std::vector<int16_t> &frames, uint64_t phase)
+{
+  size_t i = phase >> 16;
+  double f = (phase & 0xFFFF) / 65536.0;
+  int32_t s0 = frames[i];
+  int32_t s1 = frames[i + 1 < frames.size() ? i + 1 : i];
+  return (int32_t)floor(s0 + (s1 - s0) * f);
+}
+
+// Plays a one-shot sample to the end, returns the largest difference to the reference
+static int32_t playOneShot(const SampleBank &bank, uint16_t index, const Source &src, uint8_t note, uint8_t startPoint,
+                           uint32_t &played)
+{
+  SampleVoice voice;
+  voice.start(bank, index, note, true, startPoint, AUDIO_RATE);
+  uint32_t step = SampleVoice::stepFor(*bank.entry(index), (int)note - src.root, AUDIO_RATE);
+  uint64_t phase = ((uint64_t)src.frames.size() * startPoint >> 8) << 16;
+  uint32_t expected = (uint32_t)((((uint64_t)src.frames.size() << 16) - phase + step - 1) / step);
+  int32_t worst = 0;
+  played = 0;
+  while (voice.active())
+  {
+    int32_t diff = abs(voice.next() - reference(src.frames, phase));
+    worst = diff > worst ? diff : worst;
+    phase += step;
+    played++;
+    if (played > 100 * src.frames.size())
+      break;
+  }
+  check(played == expected, "one-shot length");
+  return worst;
+}
+
+static Source sine(uint32_t frames, uint32_t rate, double hz, uint8_t root)
+{
+  Source s;
+  s.rate = rate;
+  s.root = root;
+  s.loop = false;
+  s.loopStart = s.loopEnd = 0;
+  for (uint32_t i = 0; i < frames; i++)
+    s.frames.push_back((int16_t)lrint(32767 * sin(2 * M_PI * hz * i / rate) * exp(-3.0 * i / frames)));
+  return s;
+}
+
+static void checkImageFile(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    printf("FAIL: can't open %s\n", path);
+    failed++;
+    return;
+  }
+  std::vector<uint8_t> image;
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    image.insert(image.end(), buffer, buffer + n);
+  fclose(f);
+  SampleBank bank;
+  check(bank.begin(image.data(), image.size()), "packed image rejected");
+  for (uint16_t i = 0; i < bank.size(); i++)
+  {
+    const SampleEntry &e = *bank.entry(i);
+    Source src;
+    src.frames.assign(bank.data(e), bank.data(e) + e.length);
+    src.rate = e.sampleRate;
+    src.root = e.rootNote;
+    // at the root note with the sample rate converted to the audio rate, played through once
+    SampleVoice voice;
+    voice.start(bank, i, e.rootNote, true, 0, AUDIO_RATE);
+    voice.release();
+    uint32_t step = SampleVoice::stepFor(e, 0, AUDIO_RATE);
+    uint32_t played = 0;
+    int32_t worst = 0;
+    for (uint64_t phase = 0; voice.active(); phase += step, played++)
+    {
+      int32_t diff = abs(voice.next() - reference(src.frames, phase));
+      worst = diff > worst ? diff : worst;
+    }
+    printf("%s sample %u: %u frames at %u Hz, root %u%s, %u output samples, worst error %d\n", path, i, e.length,
+           e.sampleRate, e.rootNote, e.flags & SAMPLE_LOOP ? " looped" : "", played, worst);
+    check(worst <= 1, "packed sample playback");
+  }
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<Source> sources;
+  sources.push_back(sine(20000, AUDIO_RATE, 440.0, 60)); // 0: at the audio rate
+  sources.push_back(sine(30000, 44100, 997.0, 60));      // 1: resampled
+  Source looped = sine(16000, AUDIO_RATE, 220.0, 48);    // 2: sustain loop
+  looped.loop = true;
+  looped.loopStart = 4000;
+  looped.loopEnd = 12000;
+  sources.push_back(looped);
+  std::vector<uint8_t> image = buildImage(sources);
+  SampleBank bank;
+  check(bank.begin(image.data(), image.size()) && bank.size() == 3, "image rejected");
+
+  // root note: bit exact, one output sample per frame
+  SampleVoice voice;
+  voice.start(bank, 0, 60, true, 0, AUDIO_RATE);
+  bool exact = true;
+  uint32_t n = 0;
+  while (voice.active())
+    exact &= voice.next() == sources[0].frames[n++];
+  printf("root note:          %u of %zu frames played, %s\n", n, sources[0].frames.size(), exact ? "bit exact" : "differs");
+  check(exact && n == sources[0].frames.size(), "root note playback");
+
+  // an octave up plays every other frame
+  voice.start(bank, 0, 72, true, 0, AUDIO_RATE);
+  exact = true;
+  n = 0;
+  while (voice.active())
+    exact &= voice.next() == sources[0].frames[2 * n++];
+  printf("octave up:          %u output samples, %s\n", n, exact ? "bit exact" : "differs");
+  check(exact && n == sources[0].frames.size() / 2, "octave up playback");
+
+  // without tracking the note is ignored
+  voice.start(bank, 0, 30, false, 0, AUDIO_RATE);
+  check(voice.next() == sources[0].frames[0] && voice.next() == sources[0].frames[1], "tracking off");
+
+  // other pitches and sample rates: within 1 LSB of the interpolated source
+  static const int notes[] = {61, 67, 53, 36, 95};
+  for (int note : notes)
+  {
+    for (uint16_t index = 0; index < 2; index++)
+    {
+      uint32_t played;
+      int32_t worst = playOneShot(bank, index, sources[index], note, 0, played);
+      printf("sample %u note %2d:   step %6.4f, %6u output samples, worst error %d\n", index, note,
+             SampleVoice::stepFor(*bank.entry(index), note - 60, AUDIO_RATE) / 65536.0, played, worst);
+      check(worst <= 1, "interpolated playback");
+    }
+  }
+  uint32_t played;
+  check(playOneShot(bank, 1, sources[1], 64, 128, played) <= 1, "start point");
+  printf("start point 128:    %u output samples\n", played);
+
+  // the ratio of the steps follows the equal tempered scale
+  for (int semis = -24; semis <= 24; semis++)
+  {
+    double want = 44100.0 / AUDIO_RATE * pow(2.0, semis / 12.0);
+    double got = SampleVoice::stepFor(*bank.entry(1), semis, AUDIO_RATE) / 65536.0;
+    if (fabs(got / want - 1) > 0.0005)
+    {
+      printf("semitone %d: step %f, want %f\n", semis, got, want);
+      check(false, "pitch");
+    }
+  }
+
+  // sustain loop: stays inside the loop while held, plays to the end after release
+  voice.start(bank, 2, 48, true, 0, AUDIO_RATE);
+  exact = true;
+  for (n = 0; n < 100000; n++)
+  {
+    uint32_t frame = n < 12000 ? n : 4000 + (n - 12000) % 8000;
+    exact &= voice.next() == sources[2].frames[frame];
+  }
+  check(exact && voice.active(), "loop while held");
+  uint32_t frame = 4000 + (100000 - 12000) % 8000;
+  voice.release();
+  while (voice.active())
+    exact &= voice.next() == sources[2].frames[frame++];
+  printf("loop:               held for 100000 samples, released at frame %u, %s\n",
+         4000 + (100000 - 12000) % 8000, exact ? "bit exact" : "differs");
+  check(exact && frame == sources[2].frames.size(), "loop release");
+
+  // malformed images leave an empty bank
+  std::vector<uint8_t> bad = image;
+  bad[0] = 'X';
+  check(!bank.begin(bad.data(), bad.size()) && bank.size() == 0, "bad magic accepted");
+  check(!bank.begin(image.data(), image.size() - 2), "truncated image accepted");
+  bad = image;
+  SampleEntry broken;
+  memcpy(&broken, bad.data() + sizeof(SampleImageHeader) + 2 * sizeof(SampleEntry), sizeof(broken));
+  broken.loopEnd = broken.length + 1;
+  memcpy(bad.data() + sizeof(SampleImageHeader) + 2 * sizeof(SampleEntry), &broken, sizeof(broken));
+  check(!bank.begin(bad.data(), bad.size()), "loop past the end accepted");
+  check(!bank.begin(NULL, 0), "missing partition accepted");
+  voice.start(bank, 0, 60, true, 0, AUDIO_RATE);
+  check(!voice.active() && voice.next() == 0, "voice playing from an empty bank");
+
+  for (int i = 1; i < argc; i++)
+    checkImageFile(argv[i]);
+
+  printf(failed ? "FAILED\n" : "sample playback ok\n");
+  return failed ? 1 : 0;
+}
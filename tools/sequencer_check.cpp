@@ -0,0 +1,157 @@
+/*  Step timing and arpeggiator order check of include/Sequencer.h.
+
+    Runs StepClock sample by sample and block by block like
+    SynthEngine::control() does, and checks that every step and gate end
+    lands on the ideal grid (less than one sample late, at most one block
+    early), that step lengths differ by at most one block and that nothing
+    drifts over an hour of steps. Then checks external 24 PPQN sync and the
+    arpeggiator note orders. Exits with 1 on any failure.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -Iinclude tools/sequencer_check.cpp -o sequencer_check
+      ./sequencer_check
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include "Sequencer.h"
+
+static int failed = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL: %s\n", what);
+    failed++;
+  }
+}
+
+static void checkTiming(uint32_t sampleRate, uint16_t tempo, uint8_t division, uint8_t gate, uint16_t block)
+{
+  StepClock clock;
+  clock.setTempo(sampleRate, tempo, division);
+  clock.restart();
+  double stepLength = 60.0 * sampleRate * 10.0 / ((double)tempo * division); // samples
+  uint64_t samples = (uint64_t)sampleRate * 3600;
+  uint32_t steps = 0, gates = 0;
+  double worstStep = 0, worstGate = 0;
+  uint64_t lastStep = 0;
+  uint32_t shortest = 0xFFFFFFFF, longest = 0;
+  for (uint64_t n = 0; n < samples; n += block)
+  {
+    uint8_t events = clock.tick(block);
+    if (events & clockGateOff)
+    {
+      double ideal = (steps - 1) * stepLength + stepLength * gate / SEQ_GATE_FULL;
+      double late = n - ideal;
+      if (late <= -(double)block - 1e-6 || late >= 1.0 + 1e-6)
+        worstGate = late;
+      gates++;
+    }
+    if (events & clockStep)
+    {
+      double late = n - steps * stepLength;
+      if (late <= -(double)block - 1e-6 || late >= 1.0 + 1e-6)
+        worstStep = late;
+      if (steps > 0)
+      {
+        uint32_t length = (uint32_t)(n - lastStep);
+        shortest = length < shortest ? length : shortest;
+        longest = length > longest ? length : longest;
+      }
+      lastStep = n;
+      steps++;
+      clock.setGate(gate);
+    }
+  }
+  printf("%6u Hz %5.1f BPM 1/%-2u gate %u/8 block %3u: %7u steps of %9.3f samples, lengths %u..%u, %u gate ends\n",
+         sampleRate, tempo / 10.0, division * 4, gate, block, steps, stepLength, shortest, longest, gates);
+  check(worstStep == 0, "step off the ideal grid");
+  check(worstGate == 0, "gate end off the ideal grid");
+  check(longest - shortest <= block, "step lengths differ by more than one block");
+  check(fabs(steps - samples / stepLength) <= 1.0, "step count drifted");
+  // the last block may start a step whose gate ends after the hour
+  bool lastGateOpen = (steps - 1) * stepLength + stepLength * gate / SEQ_GATE_FULL >= samples;
+  check(gate >= SEQ_GATE_FULL || gates == steps || (lastGateOpen && gates + 1 == steps), "missing gate ends");
+}
+
+static void checkExternal()
+{
+  StepClock clock;
+  clock.setTempo(32768, 1200, 4);
+  clock.setExternal(true);
+  clock.restart();
+  // 24 PPQN at 120 BPM is 682.67 samples per pulse, the pulses arrive with +-20 samples of jitter
+  uint32_t steps = 0, pulses = 0, fromTick = 0;
+  uint32_t nextPulse = 0;
+  for (uint32_t n = 0; n < 32768 * 10; n++)
+  {
+    if (n == nextPulse)
+    {
+      if (clock.pulse(n))
+      {
+        steps++;
+        check(pulses % (SEQ_PPQN / 4) == 0, "external step not on every 6th pulse");
+        clock.setGate(4);
+      }
+      pulses++;
+      nextPulse = (uint32_t)lrint(pulses * 32768.0 / 48.0) + (pulses * 7919 % 41) - 20;
+    }
+    if (clock.tick(1) & clockStep)
+      fromTick++;
+  }
+  printf("external sync: %u pulses, %u steps\n", pulses, steps);
+  check(fromTick == 0, "internal clock stepped while synced");
+  check(steps == (pulses + 5) / 6, "external step count");
+}
+
+static void checkArp(uint8_t mode, uint8_t octaves, const std::vector<int> &want, const char *name)
+{
+  Arpeggiator arp;
+  arp.setMode(mode);
+  arp.setOctaves(octaves);
+  arp.press(7);
+  arp.press(0);
+  arp.press(4);
+  std::vector<int> got;
+  for (size_t i = 0; i < want.size(); i++)
+    got.push_back(arp.next());
+  printf("arp %-10s:", name);
+  for (int n : got)
+    printf(" %d", n);
+  printf("\n");
+  check(got == want, name);
+}
+
+int main()
+{
+  static const uint32_t rates[] = {16384, 32768, 48000};
+  for (uint32_t rate : rates)
+  {
+    checkTiming(rate, 1200, 4, 4, 1);
+    checkTiming(rate, 1337, 4, 3, 1);
+    checkTiming(rate, 905, 3, 7, 1);
+    checkTiming(rate, 1745, 6, SEQ_GATE_FULL, 1);
+    checkTiming(rate, 1200, 4, 4, rate / 256);
+    checkTiming(rate, 1337, 4, 3, rate / 64);
+    checkTiming(rate, 905, 3, 7, rate / 1024);
+  }
+  checkExternal();
+
+  checkArp(arpUp, 1, {0, 4, 7, 0, 4, 7}, "up");
+  checkArp(arpDown, 1, {7, 4, 0, 7, 4, 0}, "down");
+  checkArp(arpUpDown, 1, {0, 4, 7, 4, 0, 4, 7, 4}, "updown");
+  checkArp(arpAsPlayed, 1, {7, 0, 4, 7, 0, 4}, "as played");
+  checkArp(arpUp, 2, {0, 4, 7, 12, 16, 19, 0}, "up 2 oct");
+
+  Arpeggiator arp;
+  arp.press(3);
+  arp.release(5); // not held
+  arp.release(3);
+  check(arp.held() == 0 && arp.next() == -1, "release of a key that is not held");
+
+  printf(failed ? "FAILED\n" : "sequencer ok\n");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,177 @@
+/*  Zipper noise and CPU time of lower control rates with parameter smoothing.
+
+    Renders a 261.6 Hz sine whose level (OSC1_LEVEL) is swept by LFO 1 at
+    3 Hz, and the same sine through the lowpass filter with the cutoff
+    swept across it, at control rates 64..1024 Hz with smoothing off and
+    with the default one-block linear ramp (include/ParamSmoother.h).
+    Stepping a parameter once per control block puts sidebands around the
+    carrier at multiples of the control rate; the check prints the
+    strongest of them against the carrier and the CPU time per second of
+    audio, then the best of five renders at 256 Hz unsmoothed against
+    64 Hz smoothed for both sweeps. The level always ramps through the
+    block in the voice gain, so the smoothing mode only matters for the
+    cutoff. Exits with 1 when the level sidebands at 64 Hz are not below
+    LEVEL_SIDEBAND_DB or the smoothed cutoff at 64 Hz is not quieter than
+    the unsmoothed 256 Hz default.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -Iinclude -Itools tools/smoothing_check.cpp -o smoothing_check
+      ./smoothing_check
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "HostSynth.h"
+
+#define SECONDS 3
+#define WINDOW 65536 // analysed samples after the first second
+#define LEVEL_SIDEBAND_DB -50.0
+
+static const double carrier = 440.0 * pow(2.0, (60 - 69) / 12.0); // note 12 at OCTAVE 4
+
+static void configure(HostSynth &synth, bool smooth, bool filterSweep)
+{
+  synth.set("ENV1_SL", 255);
+  synth.set("ENV1_S", 30000);
+  synth.set("LFO1_STATE", 1);
+  synth.set("LFO1_FREQ", 30); // 3 Hz
+  synth.set("LFO1MODTYPE0", 1); // bipolar
+  synth.set("OSC1_TABLE", hostSin);
+  if (filterSweep) // cutoff 6..44, across the carrier
+  {
+    synth.set("FILTERSTATE", 1);
+    synth.set("FILTERCUTOFF", 25);
+    synth.set("FILTERRESONANCE", 0);
+    synth.set("LFO1AMOUNT_0", 40);
+    synth.set("LFO1VARNDX0", 7);
+  }
+  else
+  {
+    synth.set("OSC1_LEVEL", 128);
+    synth.set("LFO1AMOUNT_0", 250);
+    synth.set("LFO1VARNDX0", 0);
+  }
+  for (int i = 0; i < numModValues; i++)
+  {
+    char name[16];
+    snprintf(name, sizeof(name), "SMOOTH_MODE%d", i);
+    synth.set(name, smooth ? smoothLinear : smoothOff);
+  }
+  synth.noteOn(12);
+}
+
+static std::vector<double> render(uint32_t controlRate, bool smooth, bool filterSweep, double &seconds)
+{
+  HostSynth synth(HOST_AUDIO_RATE, controlRate);
+  configure(synth, smooth, filterSweep);
+  const uint32_t blockSize = synth.getRates().blockSize;
+  std::vector<double> out;
+  out.reserve(HOST_AUDIO_RATE * SECONDS);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t tick = 0; tick < controlRate * SECONDS; tick++)
+  {
+    synth.control();
+    for (uint32_t i = 0; i < blockSize; i++)
+      out.push_back(synth.next());
+  }
+  seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / SECONDS;
+  return out;
+}
+
+// Hann windowed magnitude at one frequency (Goertzel)
+static double magnitude(const std::vector<double> &x, double hz)
+{
+  double w = 2 * M_PI * hz / HOST_AUDIO_RATE;
+  double c = 2 * cos(w), s1 = 0, s2 = 0;
+  for (int n = 0; n < WINDOW; n++)
+  {
+    double v = x[HOST_AUDIO_RATE + n] * (0.5 - 0.5 * cos(2 * M_PI * n / WINDOW));
+    double s0 = v + c * s1 - s2;
+    s2 = s1;
+    s1 = s0;
+  }
+  return sqrt(s1 * s1 + s2 * s2 - c * s1 * s2);
+}
+
+// Strongest component within +-8 Hz (covers the 3 Hz LFO sidebands) of hz
+static double peak(const std::vector<double> &x, double hz)
+{
+  double best = 0;
+  for (double f = hz - 8; f <= hz + 8; f += 0.5)
+  {
+    double m = magnitude(x, f);
+    best = m > best ? m : best;
+  }
+  return best;
+}
+
+// Strongest control rate sideband around the carrier, dB below it
+static double sidebandDb(const std::vector<double> &x, uint32_t controlRate)
+{
+  double c = peak(x, carrier), worst = 0;
+  for (int k = 1; k <= 4; k++)
+  {
+    for (int sign = -1; sign <= 1; sign += 2)
+    {
+      double f = carrier + sign * k * (double)controlRate;
+      if (f > 20)
+      {
+        double m = peak(x, f);
+        worst = m > worst ? m : worst;
+      }
+    }
+  }
+  return 20 * log10(worst / c + 1e-12);
+}
+
+int main()
+{
+  static const uint32_t controlRates[] = {64, 128, 256, 512, 1024};
+  double smooth64Level = 0, defaultCutoff = 0, smooth64Cutoff = 0;
+  printf("control  smoothing  level sweep sidebands  cutoff sweep sidebands  CPU per second of audio\n");
+  for (uint32_t rate : controlRates)
+  {
+    for (int smooth = 0; smooth < 2; smooth++)
+    {
+      double levelSeconds, filterSeconds;
+      std::vector<double> level = render(rate, smooth, false, levelSeconds);
+      std::vector<double> filtered = render(rate, smooth, true, filterSeconds);
+      double levelDb = sidebandDb(level, rate);
+      double cutoffDb = sidebandDb(filtered, rate);
+      double cpu = (levelSeconds + filterSeconds) / 2 * 1e6;
+      printf("%5u Hz  %-9s  %10.1f dBc             %10.1f dBc          %7.0f us\n", rate, smooth ? "linear" : "off",
+             levelDb, cutoffDb, cpu);
+      if (rate == 256 && !smooth)
+      {
+        defaultCutoff = cutoffDb;
+      }
+      if (rate == 64 && smooth)
+      {
+        smooth64Level = levelDb;
+        smooth64Cutoff = cutoffDb;
+      }
+    }
+  }
+  // the CPU of the rate itself, without the render-to-render noise of the table above,
+  // for the level sweep and for the cutoff sweep, where smoothing does the most work
+  for (int filterSweep = 0; filterSweep < 2; filterSweep++)
+  {
+    double best[2] = {1e30, 1e30};
+    for (int repeat = 0; repeat < 5; repeat++)
+    {
+      for (int r = 0; r < 2; r++)
+      {
+        double seconds;
+        render(r ? 64 : 256, r == 1, filterSweep, seconds);
+        best[r] = seconds < best[r] ? seconds : best[r];
+      }
+    }
+    printf("%s sweep: 256 Hz unsmoothed %.0f us, 64 Hz smoothed %.0f us per second of audio (%+.1f %%)\n",
+           filterSweep ? "cutoff" : "level", best[0] * 1e6, best[1] * 1e6, 100.0 * (best[1] - best[0]) / best[0]);
+  }
+  bool ok = smooth64Level < LEVEL_SIDEBAND_DB && smooth64Cutoff < defaultCutoff;
+  printf(ok ? "64 Hz smoothed is quieter than 256 Hz unsmoothed\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+/*  Band level check of include/SpectrumAnalyzer.h against a double precision DFT.
+
+    Feeds full scale, -20 dB and -40 dB sines through tap() and process(),
+    on a bin centre and between bins, with and without decimation, for
+    N = 256, 512 and 1024. The reference takes the same decimated taps,
+    the same Hann window and an exact DFT in double, and reduces the bins
+    to bands like process() does (the strongest bin of a band, 0.5 dB
+    steps, 255 = full scale sine). Every band the reference puts above
+    -80 dB full scale has to match within one step; further down the
+    rounding of the fixed point FFT stages decides (-20 dB sines are two
+    steps off at -100 dB), so those bands only have to stay below the
+    sine's band. Exits with 1 on any failure.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -Iinclude tools/spectrum_check.cpp -o spectrum_check
+      ./spectrum_check
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "SpectrumAnalyzer.h"
+
+#define AUDIO_RATE 32768
+#define CHECKED_FLOOR 95 // bands from -80 dB full scale up have to match
+
+static int failed = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL: %s\n", what);
+    failed++;
+  }
+}
+
+// Bands of the same taps as process() sees them, from an exact DFT
+template <uint16_t N>
+static void referenceBands(const SpectrumAnalyzer<N> &analyzer, const std::vector<int16_t> &taps, double *bands)
+{
+  const double pi = 3.14159265358979323846;
+  const double fullScale = 32767.0 * 0.5 * N / 2; // |X[k]| of a full scale sine on a bin, Hann windowed
+  std::vector<double> level(N / 2 + 1);
+  for (uint16_t k = 1; k <= N / 2; k++)
+  {
+    double re = 0, im = 0;
+    for (uint16_t n = 0; n < N; n++)
+    {
+      double w = 0.5 * (1.0 - cos(2 * pi * n / N));
+      re += taps[n] * w * cos(2 * pi * k * n / N);
+      im -= taps[n] * w * sin(2 * pi * k * n / N);
+    }
+    double magnitude = sqrt(re * re + im * im);
+    level[k] = magnitude > 0 ? 255.0 + 2.0 * 20.0 * log10(magnitude / fullScale) : -1e9;
+  }
+  for (uint8_t b = 0; b < SPECTRUM_BANDS; b++)
+  {
+    double peak = -1e9;
+    uint16_t end = b + 1 < SPECTRUM_BANDS ? analyzer.getBandStart(b + 1) : N / 2 + 1;
+    for (uint16_t k = analyzer.getBandStart(b); k < end; k++)
+      peak = level[k] > peak ? level[k] : peak;
+    bands[b] = peak;
+  }
+}
+
+template <uint16_t N>
+static void checkSine(double hz, double db, uint8_t decimation)
+{
+  static SpectrumAnalyzer<N> analyzer;
+  analyzer.setDecimation(decimation);
+  uint8_t bands[SPECTRUM_BANDS];
+  int8_t scope[SPECTRUM_SCOPE_POINTS];
+  while (analyzer.process(bands, scope)) // drop a buffer left from the previous run
+    ;
+  const double pi = 3.14159265358979323846;
+  double amplitude = 32767.0 * pow(10.0, db / 20.0);
+  std::vector<int16_t> taps;
+  int32_t accumulator = 0;
+  // one buffer of N taps, the reference keeps its own copy of the decimated taps
+  for (uint32_t n = 0; taps.size() < N; n++)
+  {
+    int16_t sample = (int16_t)lrint(amplitude * sin(2 * pi * hz * n / AUDIO_RATE));
+    analyzer.tap(sample);
+    accumulator += sample;
+    if ((n + 1) % decimation == 0)
+    {
+      taps.push_back((int16_t)(accumulator / decimation));
+      accumulator = 0;
+    }
+  }
+  check(analyzer.process(bands, scope), "a buffer after N taps");
+
+  double reference[SPECTRUM_BANDS];
+  referenceBands(analyzer, taps, reference);
+  double top = -1e9;
+  uint8_t topBand = 0;
+  for (uint8_t b = 0; b < SPECTRUM_BANDS; b++)
+  {
+    if (reference[b] > top)
+    {
+      top = reference[b];
+      topBand = b;
+    }
+  }
+  int checked = 0, worst = 0, wrong = 0;
+  for (uint8_t b = 0; b < SPECTRUM_BANDS; b++)
+  {
+    double want = reference[b] < 0 ? 0 : reference[b] > 255 ? 255 : reference[b];
+    if (reference[b] >= CHECKED_FLOOR)
+    {
+      int error = abs(bands[b] - (int)lrint(want)); // steps off the reference rounded to a step
+      checked++;
+      worst = error > worst ? error : worst;
+      wrong += error > 1;
+    }
+    else
+    {
+      wrong += b != topBand && bands[b] >= bands[topBand];
+    }
+  }
+  printf("N %4u, decimation %u, %7.1f Hz %4.0f dB: band %2u at %3u (ref %6.1f), %2d bands checked, worst %d step%s\n",
+         N, decimation, hz, db, topBand, bands[topBand], top, checked, worst, wrong ? "  FAIL" : "");
+  check(wrong == 0, "band levels against the DFT");
+}
+
+int main()
+{
+  static const double levels[] = {0, -20, -40};
+  for (double db : levels)
+  {
+    checkSine<512>(1024.0, db, 2);    // bin centre, 32 Hz bins
+    checkSine<512>(1000.0, db, 2);    // between bins
+    checkSine<512>(5000.0, db, 1);    // no decimation, 64 Hz bins
+    checkSine<256>(440.0, db, 2);
+    checkSine<1024>(3141.6, db, 2);
+    checkSine<1024>(150.0, db, 4);
+  }
+  printf(failed ? "FAILED\n" : "spectrum ok\n");
+  return failed ? 1 : 0;
+}
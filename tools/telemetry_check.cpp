@@ -0,0 +1,134 @@
+/*  Overflow and consistency check of include/TelemetryRing.h.
+
+    First fills and drains a ring on one thread: SIZE - 1 records fit, the
+    next push is dropped and counted, a pop makes room again and the order
+    survives the index wrap. Then runs a producer thread that pushes
+    faster than the consumer thread drains, the way updateControl() /
+    updateAudio() feed telemetryTask. Every record carries its sequence
+    number in all fields, so the consumer sees a torn record (fields of two
+    different pushes) as a mismatch. Checks that records arrive in order
+    without duplicates and that popped + dropped equals pushed. Both sides
+    yield now and then, so they interleave on a single core host as well;
+    only a multi core host runs them truly in parallel like the ESP32-S3.
+    Exits with 1 on any failure.
+
+    Build and run from the project root:
+      g++ -O2 -std=c++11 -Iinclude tools/telemetry_check.cpp -o telemetry_check -lpthread
+      ./telemetry_check
+*/
+
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+#include "TelemetryRing.h"
+
+#define RING_SIZE 256
+#define PUSHES 2000000UL
+
+static int failed = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL: %s\n", what);
+    failed++;
+  }
+}
+
+static bool push(TelemetryRing<RING_SIZE> &ring, uint32_t seq)
+{
+  return ring.push(seq, telemetryCpu, (uint8_t)seq, (int16_t)(seq * 3), (int32_t)~seq);
+}
+
+static bool intact(const TelemetryRecord &r)
+{
+  uint32_t seq = r.time;
+  return r.type == telemetryCpu && r.id == (uint8_t)seq && r.a == (int16_t)(seq * 3) && r.b == (int32_t)~seq;
+}
+
+static void checkSingleThread()
+{
+  static TelemetryRing<RING_SIZE> ring;
+  uint32_t seq = 0;
+  while (push(ring, seq))
+    seq++;
+  check(seq == RING_SIZE - 1 && ring.used() == RING_SIZE - 1, "one slot stays empty");
+  check(ring.dropped() == 1, "push into a full ring is dropped and counted");
+  TelemetryRecord r;
+  uint32_t next = 0;
+  // drain and refill past the index wrap a few times
+  for (int round = 0; round < 5 * RING_SIZE; round++)
+  {
+    check(ring.pop(r) && intact(r) && r.time == next, "order across the wrap");
+    next++;
+    check(push(ring, seq++), "room after a pop");
+  }
+  while (ring.pop(r))
+  {
+    check(intact(r) && r.time == next, "drain order");
+    next++;
+  }
+  check(next == seq && ring.used() == 0 && ring.dropped() == 1, "drained");
+}
+
+static void checkThreads()
+{
+  static TelemetryRing<RING_SIZE> ring;
+  std::atomic<bool> done(false);
+  unsigned long pushed = 0, accepted = 0;
+
+  std::thread producer([&]()
+                       {
+    for (uint32_t seq = 0; seq < PUSHES; seq++)
+    {
+      accepted += push(ring, seq);
+      pushed++;
+      if ((seq & 63) == 63) // hand over now and then, so a single core host interleaves too
+        std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release); });
+
+  unsigned long popped = 0, torn = 0, disorder = 0;
+  uint32_t last = 0;
+  bool first = true;
+  volatile uint32_t work = 0;
+  TelemetryRecord r;
+  for (;;)
+  {
+    bool finished = done.load(std::memory_order_acquire);
+    if (!ring.pop(r))
+    {
+      if (finished)
+        break;
+      std::this_thread::yield();
+      continue;
+    }
+    popped++;
+    torn += !intact(r);
+    disorder += !first && r.time <= last;
+    last = r.time;
+    first = false;
+    for (int i = 0; i < 200; i++) // the consumer formats and sends, slower than a push
+      work += i;
+    if ((popped & 15) == 0)
+      std::this_thread::yield();
+  }
+  producer.join();
+
+  unsigned long dropped = ring.dropped();
+  printf("threads: %lu pushed, %lu popped, %lu dropped (%.1f %%), %lu torn, %lu out of order\n", pushed, popped,
+         dropped, 100.0 * dropped / pushed, torn, disorder);
+  check(popped == accepted && popped + dropped == pushed, "popped + dropped = pushed");
+  check(dropped > 0, "the producer outran the consumer");
+  check(torn == 0, "no torn records");
+  check(disorder == 0, "records in push order, no duplicates");
+}
+
+int main()
+{
+  checkSingleThread();
+  checkThreads();
+  printf(failed ? "FAILED\n" : "telemetry ok\n");
+  return failed ? 1 : 0;
+}